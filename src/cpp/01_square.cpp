@@ -59,8 +59,10 @@ protected:
   }
 };
 
-int main() {
-  SquareExample().RunMainLoop();
+int main(int argc, char* argv[]) {
+  SquareExample example;
+  example.ParseCommandLine(argc, argv);
+  example.RunMainLoop();
 }
 
 
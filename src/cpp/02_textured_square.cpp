@@ -99,7 +99,9 @@ protected:
   }
 };
 
-int main() {
-  TexturedSquareExample().RunMainLoop();
+int main(int argc, char* argv[]) {
+  TexturedSquareExample example;
+  example.ParseCommandLine(argc, argv);
+  example.RunMainLoop();
 }
 
@@ -71,15 +71,17 @@ public:
 
 protected:
   virtual void Render() override {
-    float t = glfwGetTime();
-    glm::mat4 camera_mat = glm::lookAt(1.5f*glm::vec3{sin(t), 1.0f, cos(t)}, glm::vec3{0.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 1.0f, 0.0f});
+    float t = GetTime();
+    glm::mat4 camera_mat = GetCameraMatrix(glm::lookAt(1.5f*glm::vec3{sin(t), 1.0f, cos(t)}, glm::vec3{0.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 1.0f, 0.0f}));
     glm::mat4 proj_mat = glm::perspectiveFov<float>(M_PI/3.0, kScreenWidth, kScreenHeight, 0.1, 100);
     gl::Uniform<glm::mat4>(prog_, "mvp") = proj_mat * camera_mat;
     cube_shape_.render();
   }
 };
 
-int main() {
-  CubeExample().RunMainLoop();
+int main(int argc, char* argv[]) {
+  CubeExample example;
+  example.ParseCommandLine(argc, argv);
+  example.RunMainLoop();
 }
 
@@ -1,6 +1,8 @@
 // Copyright (c), Tamas Csala
 
 #include "oglwrap_example.hpp"
+#include "vertex_format.hpp"
+#include "shader_permutation.hpp"
 
 #include <oglwrap/oglwrap.h>
 #include <oglwrap/shapes/cube_shape.h>
@@ -17,22 +19,60 @@ private:
   // Array buffer for storing the cylinder geometry
   gl::ArrayBuffer buffer_;
 
-  // A shader program
-  gl::Program prog_;
+  // Quantized positions (snorm16) and packed normals, 12 bytes per vertex
+  // instead of the 24 that two glm::vec3 would take
+  VertexFormat vertex_format_{VertexFormat::Position::kNormalizedShort,
+                              VertexFormat::Normal::kPacked};
+
+  // The variants of the shared lighting shader
+  ShaderPermutations shaders_;
+
+  // The cylinder has quantized positions, the cube doesn't
+  static constexpr ShaderPermutationKey kCylinderShader = MakePermutationKey(kShaderQuantizedPositions);
+  static constexpr ShaderPermutationKey kCubeShader = MakePermutationKey();
+  gl::Program& cylinder_prog_;
+  gl::Program& cube_prog_;
+
+  // With --views, the objects are drawn for every view at once, with the
+  // MULTI_VIEW variants and instanced draws. These are set up on the first
+  // such frame (see SetupMultiView), as the options are parsed after the
+  // constructor. gl::CubeShape can't be drawn instanced, so the multi-view
+  // path uses its own cube, built as a triangle list.
+  static constexpr ShaderPermutationKey kCylinderMultiViewShader =
+      MakePermutationKey(kShaderQuantizedPositions, kShaderMultiView);
+  static constexpr ShaderPermutationKey kCubeMultiViewShader = MakePermutationKey(kShaderMultiView);
+  gl::Program* cylinder_multi_view_prog_ = nullptr;
+  gl::Program* cube_multi_view_prog_ = nullptr;
+  gl::VertexArray cube_vao_;
+  gl::ArrayBuffer cube_buffer_;
+  VertexFormat cube_vertex_format_;
 
   static constexpr float kHalfHeight = 0.5f;
   static constexpr float kRadius = 0.5f;
   static constexpr int kRingsCount = 32;
   static constexpr int kSideVertices = (kRingsCount+1)*2;
   static constexpr int kVerticesPerCap = kRingsCount+2;
+  static constexpr int kCubeVertices = 6*6;
 
 public:
   CylinderExample ()
     : cube_shape_({gl::CubeShape::kPosition,
                    gl::CubeShape::kNormal})
+    , shaders_(GetProjectDir() + "/src/glsl/lighting.vert",
+               GetProjectDir() + "/src/glsl/lighting.frag",
+               [](gl::Program& prog) {
+                 (prog | "inPos").bindLocation(gl::CubeShape::kPosition);
+                 (prog | "inNormal").bindLocation(gl::CubeShape::kNormal);
+               })
+    , cylinder_prog_(shaders_.Get(kCylinderShader))
+    , cube_prog_(shaders_.Get(kCubeShader))
   {
     { // Define the cylinder geometry
-      std::vector<glm::vec3> data;
+      // Only needed until the data is uploaded
+      FrameVector<glm::vec3> positions{FrameAllocator<glm::vec3>{&frame_arena()}};
+      FrameVector<glm::vec3> normals{FrameAllocator<glm::vec3>{&frame_arena()}};
+      positions.reserve(kSideVertices + 2*kVerticesPerCap);
+      normals.reserve(kSideVertices + 2*kVerticesPerCap);
 
       gl::Bind(vao_);
       gl::Bind(buffer_);
@@ -42,83 +82,38 @@ public:
         float angle = i * 2*M_PI / kRingsCount;
 
         glm::vec3 top = {kRadius*sin(angle), kHalfHeight, kRadius*cos(angle)};
-        data.push_back(top); // position
-        data.push_back(top - glm::vec3{0, top.y, 0}); // normal
+        positions.push_back(top);
+        normals.push_back(normalize(top - glm::vec3{0, top.y, 0}));
 
         glm::vec3 bottom = {kRadius*sin(angle), -kHalfHeight, kRadius*cos(angle)};
-        data.push_back(bottom); // position
-        data.push_back(bottom - glm::vec3{0, bottom.y, 0}); // normal
+        positions.push_back(bottom);
+        normals.push_back(normalize(bottom - glm::vec3{0, bottom.y, 0}));
       }
 
       // The caps of the cylinder (to be rendered as a triangle fan)
       for (float y = -kHalfHeight; y < kHalfHeight + 1e-5; y += 2*kHalfHeight) {
         glm::vec3 center = {0, y, 0};
         glm::vec3 normal = normalize(center);
-        data.push_back(center); // position
-        data.push_back(normal); // normal
+        positions.push_back(center);
+        normals.push_back(normal);
 
         for (int i = 0; i <= kRingsCount; ++i) {
           float angle = i * 2*M_PI / kRingsCount;
-          data.push_back({kRadius*sin(angle), y, kRadius*cos(angle)}); // position
-          data.push_back(normal); // normal
+          positions.push_back({kRadius*sin(angle), y, kRadius*cos(angle)});
+          normals.push_back(normal);
         }
       }
 
-      gl::VertexAttrib positions(gl::CubeShape::kPosition);
-      positions.pointer(3, gl::DataType::kFloat, false, 2*sizeof(glm::vec3), (void*)0);
-      positions.enable();
+      buffer_.data(vertex_format_.Pack(positions.size(), positions.data(), normals.data()));
+      vertex_format_.SetupAttribs(gl::CubeShape::kPosition, gl::CubeShape::kNormal);
 
-      gl::VertexAttrib normals(gl::CubeShape::kNormal);
-      normals.pointer(3, gl::DataType::kFloat, false, 2*sizeof(glm::vec3), (void*)sizeof(glm::vec3));
-      normals.enable();
-
-      buffer_.data(data);
       gl::Unbind(buffer_);
       gl::Unbind(vao_);
     }
 
-    gl::ShaderSource vs_source;
-    vs_source.set_source(R"""(
-      #version 330 core
-      in vec4 inPos;
-      in vec3 inNormal;
-
-      uniform mat4 mvp;
-
-      out vec3 normal;
-
-      void main() {
-        normal = inNormal;
-        gl_Position = mvp * inPos;
-      })""");
-    vs_source.set_source_file("example_shader.vert");
-    gl::Shader vs(gl::kVertexShader, vs_source);
-
-    gl::ShaderSource fs_source;
-    fs_source.set_source(R"""(
-      #version 330 core
-      in vec3 normal;
-
-      uniform vec3 color;
-
-      out vec4 fragColor;
-
-      void main() {
-        vec3 lightPos = normalize(vec3(0.3, 1, 0.2));
-        float diffuseLighting = 0.9*max(dot(lightPos, normalize(normal)), 0.0) + 0.1;
-        fragColor = vec4(diffuseLighting * color, 1.0);
-      })""");
-    fs_source.set_source_file("example_shader.frag");
-    gl::Shader fs(gl::kFragmentShader, fs_source);
-
-    // Create a shader program
-    prog_.attachShader(vs);
-    prog_.attachShader(fs);
-    prog_.link();
-    gl::Use(prog_);
-
-    (prog_ | "inPos").bindLocation(gl::CubeShape::kPosition);
-    (prog_ | "inNormal").bindLocation(gl::CubeShape::kNormal);
+    for (gl::Program* prog : {&cylinder_prog_, &cube_prog_}) {
+      SetupStaticUniforms(*prog);
+    }
 
     gl::Enable(gl::kDepthTest);
 
@@ -128,39 +123,131 @@ public:
 
 protected:
   virtual void Render() override {
-    float t = glfwGetTime();
-    glm::mat4 camera_mat = glm::lookAt(2.5f*glm::vec3{sin(2*t), 1.0f, cos(2*t)},
-                                       glm::vec3{0.0f, 0.0f, 0.0f},
-                                       glm::vec3{0.0f, 1.0f, 0.0f});
-    glm::mat4 proj_mat = glm::perspectiveFov<float>(M_PI/3.0, kScreenWidth, kScreenHeight, 0.1, 100);
+    float t = GetTime();
+    glm::mat4 camera_mat = GetCameraMatrix(glm::lookAt(2.5f*glm::vec3{sin(2*t), 1.0f, cos(2*t)},
+                                                       glm::vec3{0.0f, 0.0f, 0.0f},
+                                                       glm::vec3{0.0f, 1.0f, 0.0f}));
+    if (view_count() > 1) {
+      RenderMultiView(camera_mat);
+      return;
+    }
 
-    gl::Use(prog_);
+    glm::mat4 proj_mat = glm::perspectiveFov<float>(M_PI/3.0, kScreenWidth, kScreenHeight, 0.1, 100);
 
     { // Cylinder
+      gl::Use(cylinder_prog_);
       glm::mat4 model_mat = glm::translate(glm::mat4{1.0f}, glm::vec3{1, 0, 0});
-      gl::Uniform<glm::mat4>(prog_, "mvp") = proj_mat * camera_mat * model_mat;
-      gl::Uniform<glm::vec3>(prog_, "color") = glm::vec3{1.0, 0.0, 0.0};
+      gl::Uniform<glm::mat4>(cylinder_prog_, "mvp") = proj_mat * camera_mat * model_mat;
+      gl::Uniform<glm::vec3>(cylinder_prog_, "color") = glm::vec3{1.0, 0.0, 0.0};
+      vertex_format_.SetDequantizationUniforms(cylinder_prog_);
 
       gl::Bind(vao_);
       gl::DrawArrays(gl::PrimType::kTriangleStrip, 0, kSideVertices);
-      gl::DrawArrays(gl::PrimType::kTriangleFan, kSideVertices, kSideVertices + kVerticesPerCap);
-      gl::DrawArrays(gl::PrimType::kTriangleFan, kSideVertices + kVerticesPerCap, kSideVertices + 2*kVerticesPerCap);
+      gl::DrawArrays(gl::PrimType::kTriangleFan, kSideVertices, kVerticesPerCap);
+      gl::DrawArrays(gl::PrimType::kTriangleFan, kSideVertices + kVerticesPerCap, kVerticesPerCap);
       gl::Unbind(vao_);
+      gl::Unuse(cylinder_prog_);
     }
 
     { // Cube
+      gl::Use(cube_prog_);
       glm::mat4 model_mat = glm::translate(glm::mat4{1.0f}, glm::vec3{-1, 0, 0});
-      gl::Uniform<glm::mat4>(prog_, "mvp") = proj_mat * camera_mat * model_mat;
-      gl::Uniform<glm::vec3>(prog_, "color") = glm::vec3{1.0, 1.0, 0.0};
+      gl::Uniform<glm::mat4>(cube_prog_, "mvp") = proj_mat * camera_mat * model_mat;
+      gl::Uniform<glm::vec3>(cube_prog_, "color") = glm::vec3{1.0, 1.0, 0.0};
 
       cube_shape_.render();
+      gl::Unuse(cube_prog_);
+    }
+  }
+
+private:
+  void SetupStaticUniforms(gl::Program& prog) {
+    gl::Use(prog);
+    SetDefaultLightingUniforms(prog);
+    gl::Unuse(prog);
+  }
+
+  void SetupMultiView() {
+    cylinder_multi_view_prog_ = &shaders_.Get(kCylinderMultiViewShader);
+    cube_multi_view_prog_ = &shaders_.Get(kCubeMultiViewShader);
+    for (gl::Program* prog : {cylinder_multi_view_prog_, cube_multi_view_prog_}) {
+      SetupStaticUniforms(*prog);
+    }
+
+    FrameVector<glm::vec3> positions{FrameAllocator<glm::vec3>{&frame_arena()}};
+    FrameVector<glm::vec3> normals{FrameAllocator<glm::vec3>{&frame_arena()}};
+    positions.reserve(kCubeVertices);
+    normals.reserve(kCubeVertices);
+
+    // Two triangles per face, counter-clockwise when looking at the face
+    for (int axis = 0; axis < 3; ++axis) {
+      for (float sign = -1; sign < 2; sign += 2) {
+        glm::vec3 normal{0.0f}, u{0.0f}, v{0.0f};
+        normal[axis] = sign;
+        u[(axis + 1) % 3] = 0.5f;
+        v[(axis + 2) % 3] = 0.5f * sign;
+        glm::vec3 center = 0.5f * normal;
+        glm::vec3 corners[6] = {center - u - v, center + u - v, center + u + v,
+                                center - u - v, center + u + v, center - u + v};
+        for (const glm::vec3& corner : corners) {
+          positions.push_back(corner);
+          normals.push_back(normal);
+        }
+      }
+    }
+
+    gl::Bind(cube_vao_);
+    gl::Bind(cube_buffer_);
+    cube_buffer_.data(cube_vertex_format_.Pack(positions.size(), positions.data(), normals.data()));
+    cube_vertex_format_.SetupAttribs(gl::CubeShape::kPosition, gl::CubeShape::kNormal);
+    gl::Unbind(cube_buffer_);
+    gl::Unbind(cube_vao_);
+  }
+
+  // Every object is a single draw call, however many views there are.
+  void RenderMultiView(const glm::mat4& camera_mat) {
+    if (!cylinder_multi_view_prog_) {
+      SetupMultiView();
     }
+    const MultiView& views = SetupViews(camera_mat, M_PI/3.0, 0.1, 100);
+
+    { // Cylinder
+      gl::Program& prog = *cylinder_multi_view_prog_;
+      gl::Use(prog);
+      views.Bind(prog);
+      gl::Uniform<glm::mat4>(prog, "model_mat") = glm::translate(glm::mat4{1.0f}, glm::vec3{1, 0, 0});
+      gl::Uniform<glm::vec3>(prog, "color") = glm::vec3{1.0, 0.0, 0.0};
+      vertex_format_.SetDequantizationUniforms(prog);
 
-    gl::Unuse(prog_);
+      gl::Bind(vao_);
+      glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, kSideVertices, views.instance_count());
+      glDrawArraysInstanced(GL_TRIANGLE_FAN, kSideVertices, kVerticesPerCap, views.instance_count());
+      glDrawArraysInstanced(GL_TRIANGLE_FAN, kSideVertices + kVerticesPerCap, kVerticesPerCap,
+                            views.instance_count());
+      gl::Unbind(vao_);
+      views.Unbind();
+      gl::Unuse(prog);
+    }
+
+    { // Cube
+      gl::Program& prog = *cube_multi_view_prog_;
+      gl::Use(prog);
+      views.Bind(prog);
+      gl::Uniform<glm::mat4>(prog, "model_mat") = glm::translate(glm::mat4{1.0f}, glm::vec3{-1, 0, 0});
+      gl::Uniform<glm::vec3>(prog, "color") = glm::vec3{1.0, 1.0, 0.0};
+
+      gl::Bind(cube_vao_);
+      glDrawArraysInstanced(GL_TRIANGLES, 0, kCubeVertices, views.instance_count());
+      gl::Unbind(cube_vao_);
+      views.Unbind();
+      gl::Unuse(prog);
+    }
   }
 };
 
-int main() {
-  CylinderExample().RunMainLoop();
+int main(int argc, char* argv[]) {
+  CylinderExample example;
+  example.ParseCommandLine(argc, argv);
+  example.RunMainLoop();
 }
 
@@ -1,6 +1,10 @@
 // Copyright (c), Tamas Csala
 
 #include "oglwrap_example.hpp"
+#include "transform_store.hpp"
+#include "shader_permutation.hpp"
+#include "occlusion_culler.hpp"
+#include "clustered_lights.hpp"
 
 #include <oglwrap/oglwrap.h>
 #include <oglwrap/shapes/cube_shape.h>
@@ -15,8 +19,13 @@ private:
   // Defines a unit sized sphere (see oglwrap/shapes/sphere_shape.h)
   gl::SphereShape sphere_shape_;
 
+  // The variants of the shared lighting shader
+  ShaderPermutations shaders_;
+
   // A shader program for rendering the final objects
-  gl::Program prog_;
+  static constexpr ShaderPermutationKey kRenderShader =
+      MakePermutationKey(kShaderShadows, PcfKernel(3), kShaderClusteredLights);
+  gl::Program& prog_;
 
   // A shader program for rendering the depth texture
   gl::Program shadow_prog_;
@@ -33,6 +42,23 @@ private:
   // The "position" of the directional light, directed towards the origin
   glm::vec3 light_source_pos_ = normalize(glm::vec3{0.3f, 1.0f, 0.2f});
 
+  // The model transformations of the objects, shared by both passes
+  TransformStore transforms_;
+  TransformStore::Handle sphere_transform_, cube_transform_, floor_transform_, wall_transform_;
+
+  // The per object mvp matrices of the current frame, for each pass
+  std::vector<glm::mat4> shadow_mvps_, mvps_;
+
+  // Skips the sphere and the cube in the final pass when they are occluded
+  OcclusionCuller occlusion_culler_{2};
+
+  // Small colored point lights, flying around the objects
+  std::vector<PointLight> point_lights_;
+  ClusteredLights clustered_lights_;
+
+  static constexpr int kPointLightCount = 16;
+  static constexpr int kClusterTextureUnit = 1;
+
   static constexpr int kDepthTextureResolution = 4096;
 
 public:
@@ -41,19 +67,29 @@ public:
                    gl::CubeShape::kNormal})
     , sphere_shape_({gl::SphereShape::kPosition,
                      gl::SphereShape::kNormal})
+    , shaders_(GetProjectDir() + "/src/glsl/lighting.vert",
+               GetProjectDir() + "/src/glsl/lighting.frag",
+               [](gl::Program& prog) {
+                 (prog | "inPos").bindLocation(gl::CubeShape::kPosition);
+                 (prog | "inNormal").bindLocation(gl::CubeShape::kNormal);
+               })
+    , prog_(shaders_.Get(kRenderShader))
   {
     SetupDepthTexture();
     SetupFrameBuffer();
-    SetupRenderProgram();
     SetupShadowProgram();
     SetupAttributePositions();
     SetupShadowTransform();
+    SetupTransforms();
+    SetupPointLights();
     SetupStaticUniforms();
     SetupContextParams();
   }
 
 protected:
   virtual void Render() override {
+    // The shadow pass' matrices come out of the same pass as the world matrices
+    transforms_.Update(shadow_transform_, &shadow_mvps_);
     ShadowRender();
     FinalRender();
   }
@@ -67,24 +103,22 @@ private:
     gl::Use(shadow_prog_);
 
     { // Sphere
-      glm::mat4 model_mat = glm::translate(glm::mat4{1.0f}, glm::vec3{1, 0, 0});
-      gl::Uniform<glm::mat4>(shadow_prog_, "mvp") = shadow_transform_ * model_mat;
-
+      gl::Uniform<glm::mat4>(shadow_prog_, "mvp") = shadow_mvps_[sphere_transform_];
       sphere_shape_.render();
     }
 
     { // Cube
-      glm::mat4 model_mat = glm::translate(glm::mat4{1.0f}, glm::vec3{-1, 0, 0});
-      gl::Uniform<glm::mat4>(shadow_prog_, "mvp") = shadow_transform_ * model_mat;
-
+      gl::Uniform<glm::mat4>(shadow_prog_, "mvp") = shadow_mvps_[cube_transform_];
       cube_shape_.render();
     }
 
-     { // Floor
-      glm::mat4 offset_mat = glm::translate(glm::mat4{1.0f}, glm::vec3{0, -0.505, 0});
-      glm::mat4 model_mat = glm::scale(offset_mat, glm::vec3{10, 0.1, 10});
-      gl::Uniform<glm::mat4>(shadow_prog_, "mvp") = shadow_transform_ * model_mat;
+    { // Floor
+      gl::Uniform<glm::mat4>(shadow_prog_, "mvp") = shadow_mvps_[floor_transform_];
+      cube_shape_.render();
+    }
 
+    { // Wall
+      gl::Uniform<glm::mat4>(shadow_prog_, "mvp") = shadow_mvps_[wall_transform_];
       cube_shape_.render();
     }
 
@@ -95,45 +129,76 @@ private:
   }
 
   void FinalRender() {
-    float t = glfwGetTime();
-    glm::mat4 camera_mat = glm::lookAt(2.5f*glm::vec3{sin(t), 1.0f, cos(t)},
-                                       glm::vec3{0.0f, 0.0f, 0.0f},
-                                       glm::vec3{0.0f, 1.0f, 0.0f});
+    float t = GetTime();
+    glm::mat4 camera_mat = GetCameraMatrix(glm::lookAt(2.5f*glm::vec3{sin(t), 1.0f, cos(t)},
+                                                       glm::vec3{0.0f, 0.0f, 0.0f},
+                                                       glm::vec3{0.0f, 1.0f, 0.0f}));
     glm::mat4 proj_mat = glm::perspectiveFov<float>(M_PI/3.0, kScreenWidth, kScreenHeight, 0.1, 100);
 
-    gl::Use(prog_);
-
     auto texture_bind_guard = gl::MakeTemporaryBind(depth_tex_);
 
-    { // Sphere
-      glm::mat4 model_mat = glm::translate(glm::mat4{1.0f}, glm::vec3{1, 0, 0});
-      gl::Uniform<glm::mat4>(prog_, "model_mat") = model_mat;
-      gl::Uniform<glm::mat4>(prog_, "mvp") = proj_mat * camera_mat * model_mat;
-      gl::Uniform<glm::vec3>(prog_, "color") = glm::vec3{1.0, 0.5, 1.0};
+    transforms_.ComputeMvps(proj_mat * camera_mat, &mvps_);
 
-      sphere_shape_.render();
-    }
+    UpdatePointLights(t);
+    clustered_lights_.Update(point_lights_, camera_mat);
 
-    { // Cube
-      glm::mat4 model_mat = glm::translate(glm::mat4{1.0f}, glm::vec3{-1, 0, 0});
-      gl::Uniform<glm::mat4>(prog_, "model_mat") = model_mat;
-      gl::Uniform<glm::mat4>(prog_, "mvp") = proj_mat * camera_mat * model_mat;
-      gl::Uniform<glm::vec3>(prog_, "color") = glm::vec3{0.1, 0.8, 0.4};
+    gl::Use(prog_);
+    clustered_lights_.Bind(prog_, kClusterTextureUnit, glm::vec2(kScreenWidth, kScreenHeight));
+
+    { // Floor
+      gl::Uniform<glm::mat4>(prog_, "model_mat") = transforms_.world_matrix(floor_transform_);
+      gl::Uniform<glm::mat4>(prog_, "mvp") = mvps_[floor_transform_];
+      gl::Uniform<glm::vec3>(prog_, "color") = glm::vec3{0.5, 0.5, 0.5};
 
       cube_shape_.render();
     }
 
-    { // Floor
-      glm::mat4 offset_mat = glm::translate(glm::mat4{1.0f}, glm::vec3{0, -0.505, 0});
-      glm::mat4 model_mat = glm::scale(offset_mat, glm::vec3{10, 0.1, 10});
-      gl::Uniform<glm::mat4>(prog_, "model_mat") = model_mat;
-      gl::Uniform<glm::mat4>(prog_, "mvp") = proj_mat * camera_mat * model_mat;
-      gl::Uniform<glm::vec3>(prog_, "color") = glm::vec3{0.5, 0.5, 0.5};
+    { // Wall, it's drawn before the other objects, as it's the occluder
+      gl::Uniform<glm::mat4>(prog_, "model_mat") = transforms_.world_matrix(wall_transform_);
+      gl::Uniform<glm::mat4>(prog_, "mvp") = mvps_[wall_transform_];
+      gl::Uniform<glm::vec3>(prog_, "color") = glm::vec3{0.6, 0.4, 0.3};
 
       cube_shape_.render();
     }
 
     gl::Unuse(prog_);
+
+    // The sphere and the cube are skipped while the camera is behind the wall.
+    // Both are bounded by a unit cube, so the proxy mvp is the object's.
+    TransformStore::Handle occludees[] = {sphere_transform_, cube_transform_};
+    // The results of the previous frame's queries depend on how fast the GPU
+    // is, while the conditional render's don't.
+    OcclusionCuller::Mode culling_mode = HasDeterministicTime()
+        ? OcclusionCuller::Mode::kConditionalRender
+        : OcclusionCuller::Mode::kPreviousFrame;
+    if (occlusion_culler_.mode() != culling_mode) {
+      occlusion_culler_.set_mode(culling_mode);
+    }
+    occlusion_culler_.Render(
+      [&](size_t i) { return mvps_[occludees[i]]; },
+      [&](size_t i) {
+        gl::Use(prog_);
+        gl::Uniform<glm::mat4>(prog_, "model_mat") = transforms_.world_matrix(occludees[i]);
+        gl::Uniform<glm::mat4>(prog_, "mvp") = mvps_[occludees[i]];
+        if (i == 0) { // Sphere
+          gl::Uniform<glm::vec3>(prog_, "color") = glm::vec3{1.0, 0.5, 1.0};
+          sphere_shape_.render();
+        } else { // Cube
+          gl::Uniform<glm::vec3>(prog_, "color") = glm::vec3{0.1, 0.8, 0.4};
+          cube_shape_.render();
+        }
+        gl::Unuse(prog_);
+      }, &frame_arena());
+
+    clustered_lights_.Unbind(kClusterTextureUnit);
+  }
+
+  void UpdatePointLights(float t) {
+    for (int i = 0; i < kPointLightCount; ++i) {
+      float angle = 2*M_PI*i / kPointLightCount + 0.5f*t;
+      float radius = 1.5f + 0.5f*sin(3*angle);
+      point_lights_[i].position = glm::vec3{radius*cos(angle), 0.1f + 0.3f*(i % 3), radius*sin(angle)};
+    }
   }
 
   void SetupDepthTexture() {
@@ -159,16 +224,6 @@ private:
     gl::Unbind(fbo_);
   }
 
-  void SetupRenderProgram() {
-    gl::Shader vs(gl::kVertexShader, GetProjectDir() + "/src/glsl/05_render.vert");
-    gl::Shader fs(gl::kFragmentShader, GetProjectDir() + "/src/glsl/05_render.frag");
-
-    // Create a shader program
-    prog_.attachShader(vs);
-    prog_.attachShader(fs);
-    prog_.link();
-  }
-
   void SetupShadowProgram() {
     gl::Shader vs(gl::kVertexShader, GetProjectDir() + "/src/glsl/05_shadow.vert");
     gl::Shader fs(gl::kFragmentShader, GetProjectDir() + "/src/glsl/05_shadow.frag");
@@ -180,8 +235,6 @@ private:
   }
 
   void SetupAttributePositions() {
-    (prog_ | "inPos").bindLocation(gl::CubeShape::kPosition);
-    (prog_ | "inNormal").bindLocation(gl::CubeShape::kNormal);
     (shadow_prog_ | "inPos").bindLocation(gl::CubeShape::kPosition);
   }
 
@@ -196,9 +249,35 @@ private:
     shadow_transform_ = shadow_proj * shadow_camera;
   }
 
+  void SetupTransforms() {
+    sphere_transform_ = transforms_.Add(glm::vec3{1, 0, 0});
+    cube_transform_ = transforms_.Add(glm::vec3{-1, 0, 0});
+    floor_transform_ = transforms_.Add(glm::vec3{0, -0.505, 0}, glm::quat{1, 0, 0, 0},
+                                       glm::vec3{10, 0.1, 10});
+    // Inside the camera's orbit (radius 2.5), so the camera never touches
+    // it, but it hides both objects when the camera passes behind it.
+    wall_transform_ = transforms_.Add(glm::vec3{0, 0.35, -1.8}, glm::quat{1, 0, 0, 0},
+                                      glm::vec3{2, 1.6, 0.1});
+  }
+
+  void SetupPointLights() {
+    point_lights_.resize(kPointLightCount);
+    for (int i = 0; i < kPointLightCount; ++i) {
+      float hue = float(i) / kPointLightCount;
+      point_lights_[i].radius = 1.0f;
+      // Fully saturated colors around the hue circle
+      glm::vec3 rgb = glm::abs(glm::mod(6.0f*hue + glm::vec3{0, 4, 2}, 6.0f) - 3.0f) - 1.0f;
+      point_lights_[i].color = 0.6f * glm::clamp(rgb, 0.0f, 1.0f);
+    }
+    UpdatePointLights(0.0f);
+
+    clustered_lights_.SetProjection(M_PI/3.0, float(kScreenWidth) / kScreenHeight, 0.1, 100);
+  }
+
   void SetupStaticUniforms() {
     gl::Use(prog_);
     gl::Uniform<glm::vec3>(prog_, "lightPos") = light_source_pos_;
+    gl::Uniform<float>(prog_, "ambient") = 0.1f;
     gl::Uniform<glm::mat4>(prog_, "shadowTransform") = shadow_transform_;
     gl::Unuse(prog_);
   }
@@ -209,7 +288,9 @@ private:
   }
 };
 
-int main() {
-  ShadowExample().RunMainLoop();
+int main(int argc, char* argv[]) {
+  ShadowExample example;
+  example.ParseCommandLine(argc, argv);
+  example.RunMainLoop();
 }
 
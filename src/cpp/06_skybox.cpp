@@ -1,6 +1,7 @@
 // Copyright (c), Tamas Csala
 
 #include "oglwrap_example.hpp"
+#include "asset_loader.hpp"
 
 #include <lodepng.h>
 #include <oglwrap/oglwrap.h>
@@ -12,22 +13,23 @@ class Skybox {
 private:
   gl::CubeShape cube_;
 
-  gl::Program prog_;
-  gl::TextureCube texture_;
-  gl::LazyUniform<glm::mat4> uProjectionMatrix_;
-  gl::LazyUniform<glm::mat3> uCameraMatrix_;
+  AsyncAsset<gl::Program> prog_;
+  AsyncAsset<gl::TextureCube> texture_;
 
-public:
-  Skybox(const std::string& project_dir)
-      : cube_({gl::CubeShape::kPosition})
-      , prog_{gl::Shader(gl::kVertexShader, project_dir + "/src/glsl/06_skybox.vert"),
-              gl::Shader(gl::kFragmentShader, project_dir + "/src/glsl/06_skybox.frag")}
-      , uProjectionMatrix_(prog_, "uProjectionMatrix")
-      , uCameraMatrix_(prog_, "uCameraMatrix")
-  {
+  // Created on the first frame where prog_ is ready, so the uniform
+  // locations (and their names) aren't looked up every frame.
+  std::unique_ptr<gl::LazyUniform<glm::mat4>> uProjectionMatrix_;
+  std::unique_ptr<gl::LazyUniform<glm::mat3>> uCameraMatrix_;
+
+  // The cubemap faces, cut out from the skybox image
+  struct Faces {
+    unsigned size;
+    std::vector<unsigned> data[6];
+  };
+
+  static Faces DecodeFaces(const std::string& path) {
     unsigned width, height;
     std::vector<unsigned char> data;
-    std::string path = project_dir + "/src/resource/skybox.png";
     unsigned error = lodepng::decode(data, width, height, path, LCT_RGBA, 8);
 
     if (error) {
@@ -39,9 +41,11 @@ public:
     assert(width / 4 == height / 3);
     unsigned size = width / 4;
 
-    gl::Bind(texture_);
+    Faces faces;
+    faces.size = size;
     for (int i = 0; i < 6; ++i) {
-      std::vector<unsigned> subdata;
+      std::vector<unsigned>& subdata = faces.data[i];
+      subdata.reserve(size*size);
       unsigned startx, starty;
       switch (i) {
         case 0: startx = 2*size; starty = 1*size; break;
@@ -57,78 +61,185 @@ public:
         }
       }
       assert(subdata.size() == size*size);
-      texture_.upload(texture_.cubeFace(i), gl::kSrgb8Alpha8, size, size,
-                      gl::kRgba, gl::kUnsignedByte, subdata.data());
     }
-    texture_.minFilter(gl::kLinear);
-    texture_.magFilter(gl::kLinear);
-    gl::Unbind(texture_);
-
-    gl::Use(prog_);
-    prog_.validate();
-    gl::UniformSampler(prog_, "uTex") = 0;
-    (prog_ | "aPosition").bindLocation(cube_.kPosition);
-    gl::Unuse(prog_);
+
+    return faces;
+  }
+
+  static std::unique_ptr<gl::TextureCube> UploadFaces(const Faces& faces) {
+    std::unique_ptr<gl::TextureCube> texture{new gl::TextureCube{}};
+
+    gl::Bind(*texture);
+    for (int i = 0; i < 6; ++i) {
+      texture->upload(texture->cubeFace(i), gl::kSrgb8Alpha8, faces.size, faces.size,
+                      gl::kRgba, gl::kUnsignedByte, faces.data[i].data());
+    }
+    texture->minFilter(gl::kLinear);
+    texture->magFilter(gl::kLinear);
+    gl::Unbind(*texture);
+
+    return texture;
+  }
+
+public:
+  Skybox(const std::string& project_dir, AssetLoader& loader)
+      : cube_({gl::CubeShape::kPosition})
+  {
+    std::string path = project_dir + "/src/resource/skybox.png";
+    texture_ = loader.Load<gl::TextureCube>([path]() { return DecodeFaces(path); },
+                                            &Skybox::UploadFaces);
+
+    prog_ = loader.LoadProgram(
+        project_dir + "/src/glsl/06_skybox.vert",
+        project_dir + "/src/glsl/06_skybox.frag",
+        [](gl::Program& prog) {
+          (prog | "aPosition").bindLocation(gl::CubeShape::kPosition);
+        },
+        [](gl::Program& prog) {
+          gl::UniformSampler(prog, "uTex") = 0;
+        });
+  }
+
+  bool ready() const {
+    return prog_.ready() && texture_.ready();
+  }
+
+  void Wait() const {
+    prog_.Wait();
+    texture_.Wait();
   }
 
   void Render(const glm::mat4& camera_mat, const glm::mat4& proj_mat) {
-    gl::Use(prog_);
+    // Until the skybox is loaded, the clear color acts as a placeholder.
+    if (!ready()) {
+      return;
+    }
 
-    uCameraMatrix_ = glm::mat3{camera_mat};
-    uProjectionMatrix_ = proj_mat;
+    gl::Program& prog = *prog_;
+    gl::TextureCube& texture = *texture_;
+
+    if (!uCameraMatrix_) {
+      uProjectionMatrix_.reset(new gl::LazyUniform<glm::mat4>{prog, "uProjectionMatrix"});
+      uCameraMatrix_.reset(new gl::LazyUniform<glm::mat3>{prog, "uCameraMatrix"});
+    }
+
+    gl::Use(prog);
+
+    *uCameraMatrix_ = glm::mat3{camera_mat};
+    *uProjectionMatrix_ = proj_mat;
 
     gl::TemporaryDisable depth_test{gl::kDepthTest};
     gl::TemporaryEnable cubemapSeamless{gl::kTextureCubeMapSeamless};
 
-    gl::BindToTexUnit(texture_, 0);
+    gl::BindToTexUnit(texture, 0);
     gl::DepthMask(false);
 
     cube_.render();
 
     gl::DepthMask(true);
-    gl::Unbind(texture_);
-    gl::Unuse(prog_);
+    gl::Unbind(texture);
+    gl::Unuse(prog);
   }
 };
 
 class SkyboxExample : public OglwrapExample {
 private:
+  // Decodes, uploads and links the assets in the background
+  AssetLoader loader_;
+
   Skybox skybox;
   gl::SphereShape sphere_shape_;
 
-  gl::Program prog_;
+  AsyncAsset<gl::Program> prog_;
+
+  // A trivial program that is used until prog_ is loaded
+  gl::Program placeholder_prog_;
 
 public:
   SkyboxExample ()
-    : skybox(GetProjectDir())
+    : loader_(window_)
+    , skybox(GetProjectDir(), loader_)
     , sphere_shape_({gl::SphereShape::kPosition,
                      gl::SphereShape::kNormal})
-    , prog_{gl::Shader(gl::kVertexShader, GetProjectDir() + "/src/glsl/06_cube.vert"),
-            gl::Shader(gl::kFragmentShader, GetProjectDir() + "/src/glsl/06_cube.frag")}
   {
-    (prog_ | "inPos").bindLocation(gl::SphereShape::kPosition);
-    (prog_ | "inNormal").bindLocation(gl::SphereShape::kNormal);
+    prog_ = loader_.LoadPermutation(
+        MakePermutationKey(),
+        GetProjectDir() + "/src/glsl/lighting.vert",
+        GetProjectDir() + "/src/glsl/lighting.frag",
+        [](gl::Program& prog) {
+          (prog | "inPos").bindLocation(gl::SphereShape::kPosition);
+          (prog | "inNormal").bindLocation(gl::SphereShape::kNormal);
+        },
+        [](gl::Program& prog) {
+          gl::Uniform<glm::vec3>(prog, "lightPos") = normalize(glm::vec3{-0.3, 1, -0.2});
+          gl::Uniform<float>(prog, "ambient") = 0.2f;
+          gl::Uniform<glm::vec3>(prog, "color") = glm::vec3{0.7, 0.5, 0.3};
+        });
+
+    gl::ShaderSource vs_source;
+    vs_source.set_source(R"""(
+      #version 330 core
+      in vec4 inPos;
+
+      uniform mat4 mvp;
+
+      void main() {
+        gl_Position = mvp * inPos;
+      })""");
+    vs_source.set_source_file("placeholder.vert");
+    gl::Shader vs(gl::kVertexShader, vs_source);
+
+    gl::ShaderSource fs_source;
+    fs_source.set_source(R"""(
+      #version 330 core
+      out vec4 fragColor;
+
+      void main() {
+        fragColor = vec4(0.5, 0.5, 0.5, 1.0);
+      })""");
+    fs_source.set_source_file("placeholder.frag");
+    gl::Shader fs(gl::kFragmentShader, fs_source);
+
+    placeholder_prog_.attachShader(vs);
+    placeholder_prog_.attachShader(fs);
+    (placeholder_prog_ | "inPos").bindLocation(gl::SphereShape::kPosition);
+    placeholder_prog_.link();
   }
 
 protected:
   virtual void Render() override {
-    float t = glfwGetTime();
-    glm::mat4 camera_mat = glm::lookAt(2.5f*glm::vec3{sin(0.5*t), 0.0f, cos(0.5*t)},
-                                       glm::vec3{0.0f, 0.0f, 0.0f},
-                                       glm::vec3{0.0f, 1.0f, 0.0f});
+    float t = GetTime();
+    glm::mat4 camera_mat = GetCameraMatrix(glm::lookAt(2.5f*glm::vec3{sin(0.5*t), 0.0f, cos(0.5*t)},
+                                                       glm::vec3{0.0f, 0.0f, 0.0f},
+                                                       glm::vec3{0.0f, 1.0f, 0.0f}));
     glm::mat4 proj_mat = glm::perspectiveFov<float>(M_PI/3.0, kScreenWidth, kScreenHeight, 0.1, 100);
 
+    // With a deterministic time source, every frame has to look the same on
+    // every machine, so the first frame waits for the assets.
+    if (HasDeterministicTime()) {
+      skybox.Wait();
+      prog_.Wait();
+    }
+
     skybox.Render(camera_mat, proj_mat);
 
-    gl::Use(prog_);
-    gl::Uniform<glm::mat4>(prog_, "mvp") = proj_mat * camera_mat;
+    bool prog_ready = prog_.ready();
+    if (prog_ready && skybox.ready()) {
+      ReportFullyLoaded();
+    }
+
+    gl::Program& prog = prog_ready ? *prog_ : placeholder_prog_;
+    gl::Use(prog);
+    gl::Uniform<glm::mat4>(prog, "mvp") = proj_mat * camera_mat;
     gl::TemporaryEnable depth_test{gl::kDepthTest};
     sphere_shape_.render();
-    gl::Unuse(prog_);
+    gl::Unuse(prog);
   }
 };
 
-int main() {
-  SkyboxExample().RunMainLoop();
+int main(int argc, char* argv[]) {
+  SkyboxExample example;
+  example.ParseCommandLine(argc, argv);
+  example.RunMainLoop();
 }
 
@@ -0,0 +1,63 @@
+// Copyright (c), Tamas Csala
+
+#include "allocation_counter.hpp"
+
+#include <new>
+#include <atomic>
+#include <cstdlib>
+
+// Replacing the global allocation functions, to count the heap allocations
+
+static std::atomic<size_t> heap_allocation_count{0};
+static thread_local size_t thread_heap_allocation_count = 0;
+
+size_t HeapAllocationCount() {
+  return heap_allocation_count.load(std::memory_order_relaxed);
+}
+
+size_t ThreadHeapAllocationCount() {
+  return thread_heap_allocation_count;
+}
+
+void* operator new(size_t size) {
+  heap_allocation_count.fetch_add(1, std::memory_order_relaxed);
+  thread_heap_allocation_count++;
+
+  void* ptr = std::malloc(size ? size : 1);
+  if (!ptr) {
+    throw std::bad_alloc{};
+  }
+  return ptr;
+}
+
+void* operator new[](size_t size) {
+  return ::operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return ::operator new(size);
+  } catch (const std::bad_alloc&) {
+    return nullptr;
+  }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return ::operator new(size, std::nothrow);
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  std::free(ptr);
+}
@@ -0,0 +1,14 @@
+// Copyright (c), Tamas Csala
+
+#ifndef ALLOCATION_COUNTER_HPP_
+#define ALLOCATION_COUNTER_HPP_
+
+#include <cstddef>
+
+// The number of global operator new calls so far, counted by the
+// replacement operator new in allocation_counter.cpp. Linking that file
+// replaces the allocation functions of the whole program.
+size_t HeapAllocationCount();            // on any thread
+size_t ThreadHeapAllocationCount();      // on the calling thread
+
+#endif
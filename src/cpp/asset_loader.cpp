@@ -0,0 +1,84 @@
+// Copyright (c), Tamas Csala
+
+#include "asset_loader.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+AssetLoader::AssetLoader(GLFWwindow* main_window, unsigned worker_count) {
+  // A context can only be current on one thread, so the loader gets its
+  // own, in a hidden window that shares the objects with the main one.
+  glfwWindowHint(GLFW_VISIBLE, false);
+  context_window_ = glfwCreateWindow(1, 1, "Asset loader", nullptr, main_window);
+  glfwWindowHint(GLFW_VISIBLE, true);
+
+  if (!context_window_) {
+    std::cerr << "FATAL: Couldn't create the asset loader's shared context." << std::endl;
+    std::terminate();
+  }
+
+  workers_.Start(std::max(worker_count, 1u));
+
+  GLFWwindow* context_window = context_window_;
+  gl_thread_.Start(1,
+                   [context_window]() { glfwMakeContextCurrent(context_window); },
+                   []() { glfwMakeContextCurrent(nullptr); });
+}
+
+AssetLoader::~AssetLoader() {
+  // The workers might still push tasks to the GL thread,
+  // so they have to be stopped first.
+  workers_.Stop();
+  gl_thread_.Stop();
+  glfwDestroyWindow(context_window_);
+}
+
+AsyncAsset<gl::Program> AssetLoader::LoadProgramImpl(
+    const std::string& vs_path, const std::string& fs_path,
+    std::function<void(gl::Program&)> bind_attributes,
+    std::function<void(gl::Program&)> setup,
+    ShaderPermutationKey permutation, bool is_permutation) {
+  using Sources = std::pair<std::string, std::string>;
+
+  return Load<gl::Program>(
+    [vs_path, fs_path, permutation]() {
+      return Sources{
+        ShaderPermutations::Preprocess(ShaderPermutations::ReadSource(vs_path), permutation),
+        ShaderPermutations::Preprocess(ShaderPermutations::ReadSource(fs_path), permutation)};
+    },
+    [vs_path, fs_path, bind_attributes, setup, is_permutation](const Sources& sources) {
+      auto start = std::chrono::high_resolution_clock::now();
+
+      gl::ShaderSource vs_source;
+      vs_source.set_source(sources.first);
+      vs_source.set_source_file(vs_path);
+      gl::Shader vs(gl::kVertexShader, vs_source);
+
+      gl::ShaderSource fs_source;
+      fs_source.set_source(sources.second);
+      fs_source.set_source_file(fs_path);
+      gl::Shader fs(gl::kFragmentShader, fs_source);
+
+      std::unique_ptr<gl::Program> prog{new gl::Program{}};
+      prog->attachShader(vs);
+      prog->attachShader(fs);
+      if (bind_attributes) {
+        bind_attributes(*prog);
+      }
+      prog->link();
+
+      if (is_permutation) {
+        ShaderPermutations::RecordVariant(std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start).count());
+      }
+
+      if (setup) {
+        gl::Use(*prog);
+        setup(*prog);
+        gl::Unuse(*prog);
+      }
+
+      return prog;
+    });
+}
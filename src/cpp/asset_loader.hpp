@@ -0,0 +1,193 @@
+// Copyright (c), Tamas Csala
+
+#ifndef ASSET_LOADER_HPP_
+#define ASSET_LOADER_HPP_
+
+#include <cassert>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <oglwrap/oglwrap.h>
+
+#include "shader_permutation.hpp"
+#include "task_queue.hpp"
+
+// A handle to an asset that is being loaded in the background. It becomes
+// ready once the GL commands that created it have completed on the GPU.
+// Should only be used on the main (rendering) thread.
+template<typename T>
+class AsyncAsset {
+public:
+  AsyncAsset() = default;
+
+  // Non-blocking check, returns true if the asset can be used (or its loading
+  // failed, in which case get() rethrows the error).
+  bool ready() const {
+    if (!state_) {
+      return false;
+    }
+    if (state_->ready) {
+      return true;
+    }
+    if (state_->failed.load()) {
+      state_->ready = true;
+      return true;
+    }
+
+    GLsync fence = state_->fence.load();
+    if (!fence) {
+      return false;
+    }
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+      glDeleteSync(fence);
+      state_->fence.store(nullptr);
+      state_->ready = true;
+    }
+    return state_->ready;
+  }
+
+  // Blocks until the asset is ready. For when the frames have to be
+  // reproducible, and mustn't depend on how fast the loading is.
+  void Wait() const {
+    assert(state_);
+    while (!ready()) {
+      GLsync fence = state_->fence.load();
+      if (fence) {
+        glClientWaitSync(fence, 0, kWaitTimeoutNs);
+      } else {
+        // Still being decoded or uploaded
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+  }
+
+  T& get() const {
+    // ready() has side effects, so it mustn't be compiled out with the assert
+    bool is_ready = ready();
+    assert(is_ready);
+    (void)is_ready;
+    if (state_->error) {
+      std::rethrow_exception(state_->error);
+    }
+    return *state_->value;
+  }
+
+  T& operator*() const { return get(); }
+  T* operator->() const { return &get(); }
+
+private:
+  struct State {
+    std::unique_ptr<T> value;
+    std::exception_ptr error;
+    std::atomic<GLsync> fence{nullptr};
+    std::atomic<bool> failed{false};
+    bool ready = false;
+  };
+  std::shared_ptr<State> state_;
+
+  static constexpr GLuint64 kWaitTimeoutNs = 100000000;
+
+  friend class AssetLoader;
+};
+
+// Loads assets in two stages: a CPU heavy part (file reading, decoding) that
+// runs on a thread pool, and a GL part (uploads, shader compilation and
+// linking) that runs on a single thread, with a hidden context that shares
+// its objects with the main window's context. Every GL task is followed by a
+// fence, that AsyncAsset::ready() polls without blocking.
+class AssetLoader {
+public:
+  // Has to be called from the main thread, as it creates a hidden window.
+  explicit AssetLoader(GLFWwindow* main_window,
+                       unsigned worker_count = std::thread::hardware_concurrency());
+  ~AssetLoader();
+
+  AssetLoader(const AssetLoader&) = delete;
+  AssetLoader& operator=(const AssetLoader&) = delete;
+
+  // Runs 'decode' on a worker thread, then passes its result to 'upload' that
+  // runs on the GL thread, and should return a std::unique_ptr<T>.
+  template<typename T, typename DecodeFunc, typename UploadFunc>
+  AsyncAsset<T> Load(DecodeFunc decode, UploadFunc upload) {
+    using State = typename AsyncAsset<T>::State;
+    using Decoded = decltype(decode());
+
+    AsyncAsset<T> asset;
+    asset.state_ = std::make_shared<State>();
+    std::shared_ptr<State> state = asset.state_;
+
+    RunOnWorker([this, state, decode, upload]() {
+      std::shared_ptr<Decoded> decoded;
+      try {
+        decoded = std::make_shared<Decoded>(decode());
+      } catch (...) {
+        state->error = std::current_exception();
+        state->failed.store(true);
+        return;
+      }
+
+      RunOnGLThread([state, decoded, upload]() {
+        try {
+          state->value = upload(*decoded);
+        } catch (...) {
+          state->error = std::current_exception();
+          state->failed.store(true);
+          return;
+        }
+        state->fence.store(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+        // Make sure the fence gets to the GPU, otherwise the main thread
+        // might poll it forever.
+        glFlush();
+      });
+    });
+
+    return asset;
+  }
+
+  // Reads the shader files on a worker, and compiles and links them on the
+  // GL thread. 'bind_attributes' is called before linking, 'setup' after it
+  // (with the program in use), both on the GL thread.
+  AsyncAsset<gl::Program> LoadProgram(
+      const std::string& vs_path, const std::string& fs_path,
+      std::function<void(gl::Program&)> bind_attributes,
+      std::function<void(gl::Program&)> setup = nullptr) {
+    return LoadProgramImpl(vs_path, fs_path, std::move(bind_attributes),
+                           std::move(setup), 0, false);
+  }
+
+  // Same as LoadProgram, for a variant of a shader that is used through
+  // ShaderPermutations elsewhere (like lighting.vert/frag). The defines of
+  // the key are injected into both shaders, and the compilation is counted
+  // in the ShaderPermutations statistics.
+  AsyncAsset<gl::Program> LoadPermutation(
+      ShaderPermutationKey key,
+      const std::string& vs_path, const std::string& fs_path,
+      std::function<void(gl::Program&)> bind_attributes,
+      std::function<void(gl::Program&)> setup = nullptr) {
+    return LoadProgramImpl(vs_path, fs_path, std::move(bind_attributes),
+                           std::move(setup), key, true);
+  }
+
+private:
+  GLFWwindow* context_window_;
+  TaskQueue workers_;
+  TaskQueue gl_thread_;
+
+  AsyncAsset<gl::Program> LoadProgramImpl(
+      const std::string& vs_path, const std::string& fs_path,
+      std::function<void(gl::Program&)> bind_attributes,
+      std::function<void(gl::Program&)> setup,
+      ShaderPermutationKey permutation, bool is_permutation);
+
+  void RunOnWorker(std::function<void()> task) { workers_.Push(std::move(task)); }
+  void RunOnGLThread(std::function<void()> task) { gl_thread_.Push(std::move(task)); }
+};
+
+#endif
@@ -0,0 +1,85 @@
+// Copyright (c), Tamas Csala
+
+#include "benchmark_util.hpp"
+
+#include <cmath>
+
+constexpr int BenchmarkSteps::kDefaultWarmupFrames;
+
+BenchmarkSteps::BenchmarkSteps(GLFWwindow* window, int step_count,
+                               int timed_frames_per_step, int warmup_frames)
+    : window_(window), step_count_(step_count)
+    , timed_frames_(timed_frames_per_step), warmup_frames_(warmup_frames) {
+  glGenQueries(1, &time_query_);
+}
+
+BenchmarkSteps::~BenchmarkSteps() {
+  glDeleteQueries(1, &time_query_);
+}
+
+void BenchmarkSteps::BeginFrame() {
+  if (step_finished_) {
+    total_cpu_ms_ = total_gpu_ms_ = total_value_ = 0;
+    step_finished_ = false;
+  }
+
+  // Wait for the previous frame, so only this frame's work is measured
+  glFinish();
+  frame_start_ = glfwGetTime();
+  glBeginQuery(GL_TIME_ELAPSED, time_query_);
+}
+
+bool BenchmarkSteps::EndFrame() {
+  glEndQuery(GL_TIME_ELAPSED);
+  double cpu_ms = 1000 * (glfwGetTime() - frame_start_);
+
+  if (!timed()) {
+    frame_in_step_++;
+    return false;
+  }
+
+  // Waiting for the result is fine here, it only stalls the benchmark
+  GLuint64 gpu_time_ns = 0;
+  glGetQueryObjectui64v(time_query_, GL_QUERY_RESULT, &gpu_time_ns);
+  total_cpu_ms_ += cpu_ms;
+  total_gpu_ms_ += gpu_time_ns / 1e6;
+
+  if (++frame_in_step_ < warmup_frames_ + timed_frames_) {
+    return false;
+  }
+
+  frame_in_step_ = 0;
+  step_finished_ = true;
+  if (++step_ == step_count_) {
+    glfwSetWindowShouldClose(window_, true);
+  }
+  return true;
+}
+
+void BenchmarkSteps::AddValue(double value) {
+  if (timed()) {
+    total_value_ += value;
+  }
+}
+
+void BuildSphere(int slices, int stacks, const glm::vec3& center, float radius,
+                 std::vector<glm::vec3>* positions, std::vector<glm::vec3>* normals,
+                 std::vector<glm::vec2>* texcoords) {
+  auto vertex = [&](int slice, int stack) {
+    float u = float(slice) / slices, v = float(stack) / stacks;
+    float theta = 2*M_PI*u, phi = M_PI*v;
+    glm::vec3 normal{sin(phi)*cos(theta), cos(phi), sin(phi)*sin(theta)};
+    positions->push_back(center + radius*normal);
+    normals->push_back(normal);
+    if (texcoords) {
+      texcoords->push_back(glm::vec2{u, v});
+    }
+  };
+
+  for (int stack = 0; stack < stacks; ++stack) {
+    for (int slice = 0; slice < slices; ++slice) {
+      vertex(slice, stack); vertex(slice + 1, stack); vertex(slice, stack + 1);
+      vertex(slice + 1, stack); vertex(slice + 1, stack + 1); vertex(slice, stack + 1);
+    }
+  }
+}
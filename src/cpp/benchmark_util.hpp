@@ -0,0 +1,75 @@
+// Copyright (c), Tamas Csala
+
+#ifndef BENCHMARK_UTIL_HPP_
+#define BENCHMARK_UTIL_HPP_
+
+#include <vector>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+// The frame loop of the benchmarks, that measure a few configurations
+// (steps) one after the other. Every step renders a few untimed warmup
+// frames, then the timed frames, and the benchmark prints the averages when
+// EndFrame() reports that the step is over. The window is closed after the
+// last step.
+//
+// The CPU time is measured between BeginFrame() and EndFrame(), after
+// waiting for the previous frame, so only the frame's own work is counted.
+// The GPU time of the same commands is measured with a GL_TIME_ELAPSED
+// query, that is read back at the end of every timed frame.
+class BenchmarkSteps {
+public:
+  static constexpr int kDefaultWarmupFrames = 10;
+
+  BenchmarkSteps(GLFWwindow* window, int step_count, int timed_frames_per_step,
+                 int warmup_frames = kDefaultWarmupFrames);
+  ~BenchmarkSteps();
+
+  BenchmarkSteps(const BenchmarkSteps&) = delete;
+  BenchmarkSteps& operator=(const BenchmarkSteps&) = delete;
+
+  void BeginFrame();
+
+  // Returns true if this was the last timed frame of the step. The averages
+  // stay valid until the next BeginFrame(), which starts the next step.
+  bool EndFrame();
+
+  // Adds a benchmark specific value to the step's average (like the number
+  // of culled objects), call it before EndFrame(). Only the timed frames count.
+  void AddValue(double value);
+
+  // The current step, starting from zero.
+  int step() const { return step_; }
+
+  // The index of the current frame within the step, the warmup frames first.
+  int frame_in_step() const { return frame_in_step_; }
+  int warmup_frames() const { return warmup_frames_; }
+  int timed_frames_per_step() const { return timed_frames_; }
+  bool timed() const { return frame_in_step_ >= warmup_frames_; }
+
+  // The averages over the timed frames of the step.
+  double average_cpu_ms() const { return total_cpu_ms_ / timed_frames_; }
+  double average_gpu_ms() const { return total_gpu_ms_ / timed_frames_; }
+  double average_value() const { return total_value_ / timed_frames_; }
+
+private:
+  GLFWwindow* window_;
+  int step_count_, timed_frames_, warmup_frames_;
+  int step_ = 0;
+  int frame_in_step_ = 0;
+  bool step_finished_ = false;
+
+  GLuint time_query_ = 0;
+  double frame_start_ = 0;
+  double total_cpu_ms_ = 0, total_gpu_ms_ = 0, total_value_ = 0;
+};
+
+// Appends a UV sphere as a triangle list (counter-clockwise from the
+// outside), so it can be drawn with a single glDrawArrays without an index
+// buffer. The texcoords are only generated if the pointer isn't null.
+void BuildSphere(int slices, int stacks, const glm::vec3& center, float radius,
+                 std::vector<glm::vec3>* positions, std::vector<glm::vec3>* normals,
+                 std::vector<glm::vec2>* texcoords = nullptr);
+
+#endif
@@ -0,0 +1,67 @@
+// Copyright (c), Tamas Csala
+
+#include "camera_path.hpp"
+
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+
+CameraPath::CameraPath(const std::string& path) {
+  std::ifstream file(path);
+  if (!file) {
+    std::cerr << "Couldn't open camera path: " << path << std::endl;
+    throw std::runtime_error("Couldn't open camera path");
+  }
+
+  std::string line;
+  int line_number = 0;
+  while (std::getline(file, line)) {
+    line_number++;
+    size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#') {
+      continue;
+    }
+
+    std::istringstream stream(line);
+    Keyframe key;
+    if (!(stream >> key.time >> key.eye.x >> key.eye.y >> key.eye.z
+                 >> key.target.x >> key.target.y >> key.target.z)) {
+      std::cerr << path << ":" << line_number << ": invalid keyframe" << std::endl;
+      throw std::runtime_error("Invalid camera path");
+    }
+    if (!keyframes_.empty() && key.time < keyframes_.back().time) {
+      std::cerr << path << ":" << line_number << ": keyframes aren't sorted by time" << std::endl;
+      throw std::runtime_error("Invalid camera path");
+    }
+    keyframes_.push_back(key);
+  }
+
+  if (keyframes_.empty()) {
+    std::cerr << "Camera path without keyframes: " << path << std::endl;
+    throw std::runtime_error("Invalid camera path");
+  }
+}
+
+glm::mat4 CameraPath::CameraMatrix(double time) const {
+  auto next = std::upper_bound(keyframes_.begin(), keyframes_.end(), time,
+      [](double t, const Keyframe& key) { return t < key.time; });
+
+  glm::vec3 eye, target;
+  if (next == keyframes_.begin()) {
+    eye = next->eye;
+    target = next->target;
+  } else if (next == keyframes_.end()) {
+    eye = keyframes_.back().eye;
+    target = keyframes_.back().target;
+  } else {
+    auto prev = next - 1;
+    float alpha = (time - prev->time) / (next->time - prev->time);
+    eye = glm::mix(prev->eye, next->eye, alpha);
+    target = glm::mix(prev->target, next->target, alpha);
+  }
+
+  return glm::lookAt(eye, target, glm::vec3{0.0f, 1.0f, 0.0f});
+}
@@ -0,0 +1,33 @@
+// Copyright (c), Tamas Csala
+
+#ifndef CAMERA_PATH_HPP_
+#define CAMERA_PATH_HPP_
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+// A scripted camera movement, loaded from a text file. Each non-empty line
+// that doesn't start with '#' is a keyframe:
+//
+//   time  eye.x eye.y eye.z  target.x target.y target.z
+//
+// The keyframes must be sorted by time. The camera position and target are
+// linearly interpolated between them, and clamped to the first and last
+// keyframes. The up vector is always +Y.
+class CameraPath {
+public:
+  explicit CameraPath(const std::string& path);
+
+  glm::mat4 CameraMatrix(double time) const;
+
+private:
+  struct Keyframe {
+    double time;
+    glm::vec3 eye, target;
+  };
+
+  std::vector<Keyframe> keyframes_;
+};
+
+#endif
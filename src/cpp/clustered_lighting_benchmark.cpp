@@ -0,0 +1,119 @@
+// Copyright (c), Tamas Csala
+
+// Renders a field of spheres lit by an increasing number (1 to 4096) of
+// randomly placed point lights, and reports the CPU time of the light
+// assignment, the number of light indices and the GPU time of the frame.
+
+#include "oglwrap_example.hpp"
+#include "clustered_lights.hpp"
+#include "shader_permutation.hpp"
+#include "benchmark_util.hpp"
+
+#include <cmath>
+#include <random>
+#include <oglwrap/shapes/sphere_shape.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+class ClusteredLightingBenchmark : public OglwrapExample {
+private:
+  static constexpr int kGridSize = 16;
+  // The light count is quadrupled after every step, from 1 to 4096
+  static constexpr int kStepCount = 7;
+  static constexpr int kMaxLightCount = 1 << 2*(kStepCount - 1);
+  static constexpr int kTimedFramesPerStep = 50;
+  static constexpr int kTextureUnit = 0;
+
+  gl::SphereShape sphere_shape_;
+  ShaderPermutations shaders_;
+  gl::Program& prog_;
+  ClusteredLights clustered_lights_;
+
+  glm::mat4 camera_mat_, proj_mat_;
+  std::vector<glm::mat4> model_mats_;
+  std::vector<PointLight> all_lights_, lights_;
+
+  BenchmarkSteps steps_;
+
+public:
+  ClusteredLightingBenchmark ()
+    : sphere_shape_({gl::SphereShape::kPosition,
+                     gl::SphereShape::kNormal})
+    , shaders_(GetProjectDir() + "/src/glsl/lighting.vert",
+               GetProjectDir() + "/src/glsl/lighting.frag",
+               [](gl::Program& prog) {
+                 (prog | "inPos").bindLocation(gl::SphereShape::kPosition);
+                 (prog | "inNormal").bindLocation(gl::SphereShape::kNormal);
+               })
+    , prog_(shaders_.Get(MakePermutationKey(kShaderClusteredLights)))
+    , steps_(window_, kStepCount, kTimedFramesPerStep) {
+    camera_mat_ = glm::lookAt(glm::vec3{0.0f, 0.6f * kGridSize, 0.9f * kGridSize},
+                              glm::vec3{0.0f, 0.0f, 0.0f},
+                              glm::vec3{0.0f, 1.0f, 0.0f});
+    proj_mat_ = glm::perspectiveFov<float>(M_PI/3.0, kScreenWidth, kScreenHeight, 0.1, 100);
+    clustered_lights_.SetProjection(M_PI/3.0, float(kScreenWidth) / kScreenHeight, 0.1, 100);
+
+    for (int z = 0; z < kGridSize; ++z) {
+      for (int x = 0; x < kGridSize; ++x) {
+        glm::vec3 pos = glm::vec3{x - (kGridSize - 1) / 2.0f, 0, z - (kGridSize - 1) / 2.0f};
+        model_mats_.push_back(glm::translate(glm::mat4{1.0f}, pos));
+      }
+    }
+
+    // Every step uses a prefix of the same lights, so the steps are comparable
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> pos_dist(-kGridSize / 2.0f, kGridSize / 2.0f);
+    std::uniform_real_distribution<float> unit_dist(0.0f, 1.0f);
+    for (int i = 0; i < kMaxLightCount; ++i) {
+      PointLight light;
+      light.position = glm::vec3{pos_dist(rng), 0.5f + unit_dist(rng), pos_dist(rng)};
+      light.radius = 1.0f + 2.0f * unit_dist(rng);
+      light.color = 0.2f * glm::vec3{unit_dist(rng), unit_dist(rng), unit_dist(rng)};
+      all_lights_.push_back(light);
+    }
+
+    gl::Use(prog_);
+    SetDefaultLightingUniforms(prog_);
+    gl::Uniform<glm::vec3>(prog_, "color") = glm::vec3{0.7, 0.7, 0.7};
+    gl::Unuse(prog_);
+
+    gl::Enable(gl::kDepthTest);
+    gl::ClearColor(0.1f, 0.2f, 0.3f, 1.0f);
+
+    std::cout << kGridSize * kGridSize << " spheres, " << ClusteredLights::kClusterCount
+              << " clusters, " << kTimedFramesPerStep << " timed frames per step" << std::endl;
+  }
+
+protected:
+  virtual void Render() override {
+    size_t light_count = size_t(1) << 2*steps_.step();
+    lights_.assign(all_lights_.begin(), all_lights_.begin() + light_count);
+
+    steps_.BeginFrame();
+
+    clustered_lights_.Update(lights_, camera_mat_);
+    steps_.AddValue(clustered_lights_.assignment_time_ms());
+
+    gl::Use(prog_);
+    clustered_lights_.Bind(prog_, kTextureUnit, glm::vec2{kScreenWidth, kScreenHeight});
+    for (const glm::mat4& model_mat : model_mats_) {
+      gl::Uniform<glm::mat4>(prog_, "mvp") = proj_mat_ * camera_mat_ * model_mat;
+      gl::Uniform<glm::mat4>(prog_, "model_mat") = model_mat;
+      sphere_shape_.render();
+    }
+    clustered_lights_.Unbind(kTextureUnit);
+    gl::Unuse(prog_);
+
+    if (steps_.EndFrame()) {
+      std::cout << "  " << light_count << " lights: "
+                << steps_.average_value() << " ms assignment, "
+                << steps_.average_gpu_ms() << " ms GPU, "
+                << clustered_lights_.light_index_count() << " light indices" << std::endl;
+    }
+  }
+};
+
+int main(int argc, char* argv[]) {
+  ClusteredLightingBenchmark benchmark;
+  benchmark.ParseCommandLine(argc, argv);
+  benchmark.RunMainLoop();
+}
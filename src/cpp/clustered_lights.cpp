@@ -0,0 +1,311 @@
+// Copyright (c), Tamas Csala
+
+#include "clustered_lights.hpp"
+
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <cassert>
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+  #define CLUSTERED_LIGHTS_USE_SSE 1
+  #include <xmmintrin.h>
+#else
+  #define CLUSTERED_LIGHTS_USE_SSE 0
+#endif
+
+constexpr int ClusteredLights::kTilesX;
+constexpr int ClusteredLights::kTilesY;
+constexpr int ClusteredLights::kSlices;
+constexpr int ClusteredLights::kClusterCount;
+constexpr int ClusteredLights::kTextureUnitCount;
+
+static constexpr int kTilesPerSlice = ClusteredLights::kTilesX * ClusteredLights::kTilesY;
+
+// Below this, waking up the workers costs more than what they save
+static constexpr size_t kMinLightsPerThread = 64;
+
+ClusteredLights::ClusteredLights(unsigned thread_count)
+    : thread_count_(thread_count ? thread_count : std::thread::hardware_concurrency()) {
+  thread_count_ = std::max(std::min(thread_count_, unsigned(kSlices)), 1u);
+
+  glGenBuffers(3, buffers_);
+  glGenTextures(3, textures_);
+
+  GLenum formats[3] = {GL_RG32UI, GL_R16UI, GL_RGBA32F};
+  for (int i = 0; i < 3; ++i) {
+    glBindBuffer(GL_TEXTURE_BUFFER, buffers_[i]);
+    glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, textures_[i]);
+    glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers_[i]);
+  }
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+  SetProjection(M_PI/3.0, 1.0f, 0.1f, 100.0f);
+}
+
+ClusteredLights::~ClusteredLights() {
+  glDeleteTextures(3, textures_);
+  glDeleteBuffers(3, buffers_);
+}
+
+void ClusteredLights::SetProjection(float fovy, float aspect, float z_near, float z_far) {
+  z_near_ = z_near;
+  z_far_ = z_far;
+
+  float tan_y = tan(fovy / 2);
+  float tan_x = tan_y * aspect;
+
+  for (auto vec : {&bounds_.min_x, &bounds_.min_y, &bounds_.min_depth,
+                   &bounds_.max_x, &bounds_.max_y, &bounds_.max_depth}) {
+    vec->resize(kClusterCount);
+  }
+
+  for (int slice = 0; slice < kSlices; ++slice) {
+    // Exponential slices, so the clusters are roughly cube shaped
+    float near_depth = z_near * pow(z_far / z_near, float(slice) / kSlices);
+    float far_depth = z_near * pow(z_far / z_near, float(slice + 1) / kSlices);
+
+    for (int y = 0; y < kTilesY; ++y) {
+      float ndc_y0 = -1.0f + 2.0f * y / kTilesY;
+      float ndc_y1 = -1.0f + 2.0f * (y + 1) / kTilesY;
+
+      for (int x = 0; x < kTilesX; ++x) {
+        float ndc_x0 = -1.0f + 2.0f * x / kTilesX;
+        float ndc_x1 = -1.0f + 2.0f * (x + 1) / kTilesX;
+
+        int cluster = (slice * kTilesY + y) * kTilesX + x;
+        bounds_.min_x[cluster] = std::min(ndc_x0 * near_depth, ndc_x0 * far_depth) * tan_x;
+        bounds_.max_x[cluster] = std::max(ndc_x1 * near_depth, ndc_x1 * far_depth) * tan_x;
+        bounds_.min_y[cluster] = std::min(ndc_y0 * near_depth, ndc_y0 * far_depth) * tan_y;
+        bounds_.max_y[cluster] = std::max(ndc_y1 * near_depth, ndc_y1 * far_depth) * tan_y;
+        bounds_.min_depth[cluster] = near_depth;
+        bounds_.max_depth[cluster] = far_depth;
+      }
+    }
+  }
+}
+
+void ClusteredLights::AssignSlices(int first_slice, int last_slice,
+                                   SliceRangeResult* result) const {
+  result->offsets_and_counts.assign(2 * (last_slice - first_slice) * kTilesPerSlice, 0);
+  result->indices.clear();
+
+  const Lights& lights = view_lights_;
+  size_t padded_light_count = lights.x.size();
+
+  // The lights that intersect the current slice (padded to a multiple of
+  // four, the padding has a negative squared radius, so it never passes)
+  std::vector<float>& x = result->slice_lights.x;
+  std::vector<float>& y = result->slice_lights.y;
+  std::vector<float>& depth = result->slice_lights.depth;
+  std::vector<float>& radius_sqr = result->slice_lights.radius_sqr;
+  std::vector<uint16_t>& index = result->slice_light_indices;
+
+  for (int slice = first_slice; slice < last_slice; ++slice) {
+    int first_cluster = slice * kTilesPerSlice;
+    float slice_near = bounds_.min_depth[first_cluster];
+    float slice_far = bounds_.max_depth[first_cluster];
+
+    x.clear(); y.clear(); depth.clear(); radius_sqr.clear(); index.clear();
+    auto gather = [&](size_t i) {
+      x.push_back(lights.x[i]);
+      y.push_back(lights.y[i]);
+      depth.push_back(lights.depth[i]);
+      radius_sqr.push_back(lights.radius[i] * lights.radius[i]);
+      index.push_back(i);
+    };
+
+#if CLUSTERED_LIGHTS_USE_SSE
+    __m128 near4 = _mm_set1_ps(slice_near), far4 = _mm_set1_ps(slice_far);
+    for (size_t i = 0; i < padded_light_count; i += 4) {
+      __m128 d = _mm_loadu_ps(&lights.depth[i]);
+      __m128 r = _mm_loadu_ps(&lights.radius[i]);
+      __m128 mask = _mm_and_ps(_mm_cmplt_ps(_mm_sub_ps(d, r), far4),
+                               _mm_cmpgt_ps(_mm_add_ps(d, r), near4));
+      int bits = _mm_movemask_ps(mask);
+      for (int j = 0; bits; ++j, bits >>= 1) {
+        if (bits & 1) {
+          gather(i + j);
+        }
+      }
+    }
+#else
+    for (size_t i = 0; i < padded_light_count; ++i) {
+      if (lights.depth[i] - lights.radius[i] < slice_far &&
+          lights.depth[i] + lights.radius[i] > slice_near) {
+        gather(i);
+      }
+    }
+#endif
+
+    while (x.size() % 4 != 0) {
+      x.push_back(0); y.push_back(0); depth.push_back(0); radius_sqr.push_back(-1);
+      index.push_back(0);
+    }
+
+    for (int tile = 0; tile < kTilesPerSlice; ++tile) {
+      int cluster = first_cluster + tile;
+      uint32_t offset = result->indices.size();
+
+#if CLUSTERED_LIGHTS_USE_SSE
+      __m128 zero = _mm_setzero_ps();
+      __m128 min_x = _mm_set1_ps(bounds_.min_x[cluster]);
+      __m128 max_x = _mm_set1_ps(bounds_.max_x[cluster]);
+      __m128 min_y = _mm_set1_ps(bounds_.min_y[cluster]);
+      __m128 max_y = _mm_set1_ps(bounds_.max_y[cluster]);
+      __m128 min_d = _mm_set1_ps(bounds_.min_depth[cluster]);
+      __m128 max_d = _mm_set1_ps(bounds_.max_depth[cluster]);
+
+      for (size_t i = 0; i < x.size(); i += 4) {
+        // The distance between the light's center and the cluster's box
+        __m128 lx = _mm_loadu_ps(&x[i]), ly = _mm_loadu_ps(&y[i]), ld = _mm_loadu_ps(&depth[i]);
+        __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(min_x, lx), _mm_sub_ps(lx, max_x)), zero);
+        __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(min_y, ly), _mm_sub_ps(ly, max_y)), zero);
+        __m128 dd = _mm_max_ps(_mm_max_ps(_mm_sub_ps(min_d, ld), _mm_sub_ps(ld, max_d)), zero);
+        __m128 dist_sqr = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                                     _mm_mul_ps(dd, dd));
+        int bits = _mm_movemask_ps(_mm_cmple_ps(dist_sqr, _mm_loadu_ps(&radius_sqr[i])));
+        for (int j = 0; bits; ++j, bits >>= 1) {
+          if (bits & 1) {
+            result->indices.push_back(index[i + j]);
+          }
+        }
+      }
+#else
+      for (size_t i = 0; i < x.size(); ++i) {
+        float dx = std::max(std::max(bounds_.min_x[cluster] - x[i], x[i] - bounds_.max_x[cluster]), 0.0f);
+        float dy = std::max(std::max(bounds_.min_y[cluster] - y[i], y[i] - bounds_.max_y[cluster]), 0.0f);
+        float dd = std::max(std::max(bounds_.min_depth[cluster] - depth[i],
+                                     depth[i] - bounds_.max_depth[cluster]), 0.0f);
+        if (dx*dx + dy*dy + dd*dd <= radius_sqr[i]) {
+          result->indices.push_back(index[i]);
+        }
+      }
+#endif
+
+      int local_cluster = cluster - first_slice * kTilesPerSlice;
+      result->offsets_and_counts[2*local_cluster] = offset;
+      result->offsets_and_counts[2*local_cluster + 1] = result->indices.size() - offset;
+    }
+  }
+}
+
+void ClusteredLights::AssignThreadSlices(unsigned t) {
+  int first_slice = t * kSlices / active_thread_count_;
+  int last_slice = (t + 1) * kSlices / active_thread_count_;
+  AssignSlices(first_slice, last_slice, &thread_results_[t]);
+}
+
+void ClusteredLights::Update(const std::vector<PointLight>& lights,
+                             const glm::mat4& camera_mat) {
+  assert(lights.size() <= 65536);
+  auto start = std::chrono::high_resolution_clock::now();
+
+  // Transform the lights into view space
+  size_t padded_light_count = (lights.size() + 3) / 4 * 4;
+  view_lights_.x.resize(padded_light_count);
+  view_lights_.y.resize(padded_light_count);
+  view_lights_.depth.resize(padded_light_count);
+  view_lights_.radius.resize(padded_light_count);
+  for (size_t i = 0; i < padded_light_count; ++i) {
+    if (i < lights.size()) {
+      glm::vec4 pos = camera_mat * glm::vec4{lights[i].position, 1.0f};
+      view_lights_.x[i] = pos.x;
+      view_lights_.y[i] = pos.y;
+      view_lights_.depth[i] = -pos.z;
+      view_lights_.radius[i] = lights[i].radius;
+    } else {
+      // Padding, that is never in any slice
+      view_lights_.x[i] = view_lights_.y[i] = 0.0f;
+      view_lights_.depth[i] = -1e30f;
+      view_lights_.radius[i] = 0.0f;
+    }
+  }
+
+  // Split the slices between the threads
+  active_thread_count_ = std::max<size_t>(
+      std::min<size_t>(thread_count_, lights.size() / kMinLightsPerThread), 1);
+  // Never shrinks, so the threads keep their scratch arrays
+  if (thread_results_.size() < active_thread_count_) {
+    thread_results_.resize(active_thread_count_);
+  }
+  // The workers are only started once there are enough lights to need them
+  if (active_thread_count_ > 1 && workers_.thread_count() == 0) {
+    workers_.Start(thread_count_ - 1);
+    workers_.Reserve(thread_count_ - 1);
+  }
+  for (unsigned t = 1; t < active_thread_count_; ++t) {
+    // Small enough for std::function to store it without allocating
+    workers_.Push([this, t]() { AssignThreadSlices(t); });
+  }
+  AssignThreadSlices(0);
+  workers_.Wait();
+
+  // Merge the threads' results, they cover consecutive clusters
+  clusters_.resize(2 * kClusterCount);
+  light_indices_.clear();
+  size_t cluster_base = 0;
+  for (unsigned t = 0; t < active_thread_count_; ++t) {
+    const SliceRangeResult& result = thread_results_[t];
+    uint32_t index_base = light_indices_.size();
+    size_t cluster_count = result.offsets_and_counts.size() / 2;
+    for (size_t i = 0; i < cluster_count; ++i) {
+      clusters_[2*(cluster_base + i)] = index_base + result.offsets_and_counts[2*i];
+      clusters_[2*(cluster_base + i) + 1] = result.offsets_and_counts[2*i + 1];
+    }
+    light_indices_.insert(light_indices_.end(), result.indices.begin(), result.indices.end());
+    cluster_base += cluster_count;
+  }
+  assert(cluster_base == size_t(kClusterCount));
+
+  light_data_.resize(2 * lights.size());
+  for (size_t i = 0; i < lights.size(); ++i) {
+    light_data_[2*i] = glm::vec4{lights[i].position, lights[i].radius};
+    light_data_[2*i + 1] = glm::vec4{lights[i].color, 0.0f};
+  }
+
+  assignment_time_ms_ = std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - start).count();
+
+  // Orphan and refill the buffers
+  const void* data[3] = {clusters_.data(), light_indices_.data(), light_data_.data()};
+  size_t sizes[3] = {clusters_.size() * sizeof(uint32_t),
+                     light_indices_.size() * sizeof(uint16_t),
+                     light_data_.size() * sizeof(glm::vec4)};
+  for (int i = 0; i < 3; ++i) {
+    glBindBuffer(GL_TEXTURE_BUFFER, buffers_[i]);
+    if (sizes[i] > 0) {
+      glBufferData(GL_TEXTURE_BUFFER, sizes[i], data[i], GL_STREAM_DRAW);
+    } else {
+      glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+    }
+  }
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void ClusteredLights::Bind(gl::Program& prog, int first_texture_unit,
+                           glm::vec2 screen_size) const {
+  for (int i = 0; i < kTextureUnitCount; ++i) {
+    glActiveTexture(GL_TEXTURE0 + first_texture_unit + i);
+    glBindTexture(GL_TEXTURE_BUFFER, textures_[i]);
+  }
+  glActiveTexture(GL_TEXTURE0);
+
+  gl::UniformSampler(prog, "uClusters") = first_texture_unit;
+  gl::UniformSampler(prog, "uLightIndices") = first_texture_unit + 1;
+  gl::UniformSampler(prog, "uLights") = first_texture_unit + 2;
+  gl::Uniform<glm::ivec3>(prog, "uClusterGrid") = glm::ivec3{kTilesX, kTilesY, kSlices};
+  gl::Uniform<glm::vec2>(prog, "uScreenSize") = screen_size;
+  gl::Uniform<glm::vec2>(prog, "uNearFar") = glm::vec2{z_near_, z_far_};
+}
+
+void ClusteredLights::Unbind(int first_texture_unit) const {
+  for (int i = 0; i < kTextureUnitCount; ++i) {
+    glActiveTexture(GL_TEXTURE0 + first_texture_unit + i);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+  }
+  glActiveTexture(GL_TEXTURE0);
+}
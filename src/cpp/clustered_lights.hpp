@@ -0,0 +1,112 @@
+// Copyright (c), Tamas Csala
+
+#ifndef CLUSTERED_LIGHTS_HPP_
+#define CLUSTERED_LIGHTS_HPP_
+
+#include <vector>
+#include <cstdint>
+#include <glad/glad.h>
+#include <oglwrap/oglwrap.h>
+#include <glm/glm.hpp>
+
+#include "task_queue.hpp"
+
+struct PointLight {
+  glm::vec3 position;
+  float radius;      // the light has no effect beyond this distance
+  glm::vec3 color;
+};
+
+// Clustered forward lighting: the view frustum is split into a grid of
+// kTilesX x kTilesY screen tiles and kSlices exponentially distributed depth
+// slices, and each cluster gets the list of point lights that reach into it.
+// The lists are built on the CPU (on several threads, testing four lights
+// at once with SSE), and uploaded into texture buffers, that the
+// CLUSTERED_LIGHTS variant of lighting.frag reads.
+class ClusteredLights {
+public:
+  static constexpr int kTilesX = 16;
+  static constexpr int kTilesY = 16;
+  static constexpr int kSlices = 24;
+  static constexpr int kClusterCount = kTilesX * kTilesY * kSlices;
+
+  // The texture units used, starting from first_texture_unit:
+  // the clusters, the light indices and the light data.
+  static constexpr int kTextureUnitCount = 3;
+
+  explicit ClusteredLights(unsigned thread_count = 0);
+  ~ClusteredLights();
+
+  ClusteredLights(const ClusteredLights&) = delete;
+  ClusteredLights& operator=(const ClusteredLights&) = delete;
+
+  // Has to match the projection matrix used for rendering
+  // (fovy is the vertical field of view in radians).
+  void SetProjection(float fovy, float aspect, float z_near, float z_far);
+
+  // Assigns the lights to the clusters, and uploads the results.
+  // At most 65536 lights are supported.
+  void Update(const std::vector<PointLight>& lights, const glm::mat4& camera_mat);
+
+  // Binds the texture buffers, and sets the uniforms of the program,
+  // that has to be in use.
+  void Bind(gl::Program& prog, int first_texture_unit, glm::vec2 screen_size) const;
+  void Unbind(int first_texture_unit) const;
+
+  // Statistics of the last Update()
+  double assignment_time_ms() const { return assignment_time_ms_; }
+  size_t light_index_count() const { return light_indices_.size(); }
+
+private:
+  unsigned thread_count_;
+  float z_near_ = 0.1f, z_far_ = 100.0f;
+
+  // View space bounding boxes of the clusters, depth is positive
+  struct ClusterBounds {
+    std::vector<float> min_x, min_y, min_depth;
+    std::vector<float> max_x, max_y, max_depth;
+  } bounds_;
+
+  // View space lights (structure of arrays, padded to a multiple of four)
+  struct Lights {
+    std::vector<float> x, y, depth, radius;
+  } view_lights_;
+
+  // The lights that intersect a slice, with squared radii for the tile tests.
+  struct SliceLights {
+    std::vector<float> x, y, depth, radius_sqr;
+  };
+
+  // The output of one thread, for a range of slices. The scratch arrays are
+  // kept between the updates, and the threads are persistent, so once the
+  // arrays have grown to fit the light count, an update doesn't allocate.
+  struct SliceRangeResult {
+    std::vector<uint32_t> offsets_and_counts;
+    std::vector<uint16_t> indices;
+
+    SliceLights slice_lights;
+    std::vector<uint16_t> slice_light_indices;
+  };
+  std::vector<SliceRangeResult> thread_results_;
+
+  // thread_count_ - 1 persistent workers, started by the first Update() that
+  // has enough lights for more than one thread. The calling thread does a
+  // share too.
+  TaskQueue workers_;
+  unsigned active_thread_count_ = 1;
+
+  std::vector<uint32_t> clusters_;  // (offset, count) pairs
+  std::vector<uint16_t> light_indices_;
+  std::vector<glm::vec4> light_data_;  // (position, radius), (color, 0) pairs
+
+  GLuint buffers_[3] = {};
+  GLuint textures_[3] = {};
+
+  double assignment_time_ms_ = 0.0;
+
+  void AssignSlices(int first_slice, int last_slice, SliceRangeResult* result) const;
+  // The share of the t-th of the active threads
+  void AssignThreadSlices(unsigned t);
+};
+
+#endif
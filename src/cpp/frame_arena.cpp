@@ -0,0 +1,71 @@
+// Copyright (c), Tamas Csala
+
+#include "frame_arena.hpp"
+
+#include <new>
+#include <cassert>
+#include <algorithm>
+
+constexpr size_t FrameArena::kDefaultCapacity;
+
+// Keeps the memory after the link of an overflow block aligned
+static constexpr size_t kOverflowHeaderSize = alignof(std::max_align_t);
+static_assert(kOverflowHeaderSize >= sizeof(void*), "The link doesn't fit into the header");
+
+FrameArena::FrameArena(size_t capacity)
+    : buffer_(new char[capacity]), capacity_(capacity) {
+}
+
+FrameArena::~FrameArena() {
+  FreeOverflow();
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment) {
+  assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+  assert(alignment <= alignof(std::max_align_t));
+
+  // new char[] is aligned for any type, so it is enough to align the offset
+  size_t aligned_offset = (offset_ + alignment - 1) & ~(alignment - 1);
+  if (aligned_offset + size <= capacity_) {
+    used_ += aligned_offset + size - offset_;
+    offset_ = aligned_offset + size;
+    return buffer_.get() + aligned_offset;
+  } else {
+    used_ += size;
+    return AllocateOverflow(size);
+  }
+}
+
+void* FrameArena::AllocateOverflow(size_t size) {
+  char* memory = static_cast<char*>(::operator new(kOverflowHeaderSize + size));
+  OverflowBlock* block = reinterpret_cast<OverflowBlock*>(memory);
+  block->next = overflow_blocks_;
+  overflow_blocks_ = block;
+
+  overflow_count_++;
+  overflowed_this_frame_ = true;
+  return memory + kOverflowHeaderSize;
+}
+
+void FrameArena::FreeOverflow() {
+  while (overflow_blocks_) {
+    OverflowBlock* next = overflow_blocks_->next;
+    ::operator delete(overflow_blocks_);
+    overflow_blocks_ = next;
+  }
+}
+
+void FrameArena::Reset() {
+  high_water_mark_ = std::max(high_water_mark_, used_);
+  FreeOverflow();
+
+  // Grow once here, instead of overflowing in every frame from now on
+  if (overflowed_this_frame_) {
+    capacity_ = std::max(2 * capacity_, high_water_mark_);
+    buffer_.reset(new char[capacity_]);
+    overflowed_this_frame_ = false;
+  }
+
+  offset_ = 0;
+  used_ = 0;
+}
@@ -0,0 +1,116 @@
+// Copyright (c), Tamas Csala
+
+#ifndef FRAME_ARENA_HPP_
+#define FRAME_ARENA_HPP_
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <algorithm>
+
+// A linear (bump) allocator for data that only lives until the end of the
+// current frame. Allocating is a pointer increment, freeing individual
+// allocations is a no-op, and Reset() frees everything at once.
+//
+// If a frame needs more memory than the capacity, the rest is allocated from
+// the heap (these are freed by the next Reset()), and the next Reset() grows
+// the buffer to the high-water mark, so a steady state frame never touches
+// the heap. The memory of a growing vector isn't reused, so reserve() when
+// the size is known in advance.
+//
+// Not thread safe, it should only be used from the render thread.
+class FrameArena {
+public:
+  static constexpr size_t kDefaultCapacity = 1 << 20;
+
+  explicit FrameArena(size_t capacity = kDefaultCapacity);
+  ~FrameArena();
+
+  FrameArena(const FrameArena&) = delete;
+  FrameArena& operator=(const FrameArena&) = delete;
+
+  // The alignment has to be a power of two, at most alignof(std::max_align_t).
+  void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+  // Frees every allocation made since the last reset.
+  void Reset();
+
+  size_t capacity() const { return capacity_; }
+
+  // The bytes allocated since the last reset, including the overflow.
+  size_t used() const { return used_; }
+
+  // The most bytes that were used in a frame.
+  size_t high_water_mark() const { return std::max(high_water_mark_, used_); }
+
+  // The number of allocations that didn't fit into the buffer.
+  size_t overflow_count() const { return overflow_count_; }
+
+private:
+  std::unique_ptr<char[]> buffer_;
+  size_t capacity_;
+  size_t offset_ = 0;
+  size_t used_ = 0;
+  size_t high_water_mark_ = 0;
+  size_t overflow_count_ = 0;
+
+  // The heap allocations of the current frame form a singly linked list,
+  // the link is stored in front of the returned memory.
+  struct OverflowBlock {
+    OverflowBlock* next;
+  };
+  OverflowBlock* overflow_blocks_ = nullptr;
+  bool overflowed_this_frame_ = false;
+
+  void* AllocateOverflow(size_t size);
+  void FreeOverflow();
+};
+
+// An STL-compatible allocator that allocates from a FrameArena, so
+// containers that are rebuilt every frame don't allocate from the heap.
+// The container must not outlive the frame. With a null arena, it uses
+// the heap, like std::allocator.
+template<typename T>
+class FrameAllocator {
+public:
+  using value_type = T;
+
+  explicit FrameAllocator(FrameArena* arena = nullptr) : arena_(arena) {}
+
+  template<typename U>
+  FrameAllocator(const FrameAllocator<U>& other) : arena_(other.arena()) {}
+
+  T* allocate(size_t n) {
+    if (arena_) {
+      return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+    } else {
+      return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+  }
+
+  void deallocate(T* ptr, size_t) {
+    if (!arena_) {
+      ::operator delete(ptr);
+    }
+  }
+
+  FrameArena* arena() const { return arena_; }
+
+private:
+  FrameArena* arena_;
+};
+
+template<typename T, typename U>
+bool operator==(const FrameAllocator<T>& lhs, const FrameAllocator<U>& rhs) {
+  return lhs.arena() == rhs.arena();
+}
+
+template<typename T, typename U>
+bool operator!=(const FrameAllocator<T>& lhs, const FrameAllocator<U>& rhs) {
+  return lhs.arena() != rhs.arena();
+}
+
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+#endif
@@ -0,0 +1,65 @@
+// Copyright (c), Tamas Csala
+
+#include "multi_view.hpp"
+
+#include <cassert>
+
+constexpr int MultiView::kMaxViews;
+
+// Fixed strings, so setting the uniforms doesn't have to build them
+static const char* const kViewProjNames[MultiView::kMaxViews] = {
+  "uViewProjs[0]", "uViewProjs[1]", "uViewProjs[2]", "uViewProjs[3]"
+};
+static const char* const kViewRectNames[MultiView::kMaxViews] = {
+  "uViewRects[0]", "uViewRects[1]", "uViewRects[2]", "uViewRects[3]"
+};
+
+// The clip distances written by lighting.vert (left, right, bottom, top)
+static constexpr int kClipDistanceCount = 4;
+
+void MultiView::AddView(const glm::mat4& view_proj, const glm::vec4& viewport,
+                        const glm::vec2& screen_size) {
+  assert(view_count_ < kMaxViews);
+
+  glm::vec2 offset = glm::vec2{viewport.x, viewport.y} / screen_size;
+  glm::vec2 scale = glm::vec2{viewport.z, viewport.w} / screen_size;
+  // The center of the viewport, mapped to [-1, 1]
+  glm::vec2 ndc_center = 2.0f*offset + scale - 1.0f;
+
+  view_projs_[view_count_] = view_proj;
+  ndc_rects_[view_count_] = glm::vec4{ndc_center, scale};
+  view_count_++;
+}
+
+glm::vec4 MultiView::SplitScreenViewport(int index, int count, const glm::vec2& screen_size) {
+  assert(0 <= index && index < count && count <= kMaxViews);
+
+  if (count == 1) {
+    return glm::vec4{0, 0, screen_size};
+  } else if (count == 2) {
+    glm::vec2 size = {screen_size.x / 2, screen_size.y};
+    return glm::vec4{index * size.x, 0, size};
+  } else {
+    // The first view is at the top left
+    glm::vec2 size = screen_size / 2.0f;
+    return glm::vec4{(index % 2) * size.x, (1 - index / 2) * size.y, size};
+  }
+}
+
+void MultiView::Bind(gl::Program& prog) const {
+  gl::Uniform<int>(prog, "uViewCount") = view_count_;
+  for (int i = 0; i < view_count_; ++i) {
+    gl::Uniform<glm::mat4>(prog, kViewProjNames[i]) = view_projs_[i];
+    gl::Uniform<glm::vec4>(prog, kViewRectNames[i]) = ndc_rects_[i];
+  }
+
+  for (int i = 0; i < kClipDistanceCount; ++i) {
+    glEnable(GL_CLIP_DISTANCE0 + i);
+  }
+}
+
+void MultiView::Unbind() const {
+  for (int i = 0; i < kClipDistanceCount; ++i) {
+    glDisable(GL_CLIP_DISTANCE0 + i);
+  }
+}
@@ -0,0 +1,49 @@
+// Copyright (c), Tamas Csala
+
+#ifndef MULTI_VIEW_HPP_
+#define MULTI_VIEW_HPP_
+
+#include <glad/glad.h>
+#include <oglwrap/oglwrap.h>
+#include <glm/glm.hpp>
+
+// Renders the scene from several cameras (split-screen, stereo pairs) in a
+// single pass. Every draw call is issued once, with view_count() times as
+// many instances, and the MULTI_VIEW variant of lighting.vert picks the view
+// from gl_InstanceID. GL 3.3 can't select the viewport from the vertex
+// shader, so the shader maps each view to its rectangle in NDC, and uses
+// clip distances to keep the views from drawing over each other.
+class MultiView {
+public:
+  // Has to match MAX_VIEWS in lighting.vert.
+  static constexpr int kMaxViews = 4;
+
+  void Clear() { view_count_ = 0; }
+
+  // The viewport is (x, y, width, height) in pixels, inside the screen.
+  void AddView(const glm::mat4& view_proj, const glm::vec4& viewport,
+               const glm::vec2& screen_size);
+
+  int view_count() const { return view_count_; }
+
+  // The number of instances to draw, for the given instances per view.
+  GLsizei instance_count(GLsizei instances_per_view = 1) const {
+    return instances_per_view * view_count_;
+  }
+
+  // The viewport of the index-th view, when the screen is split into count
+  // views: side by side for two, and a 2x2 grid for three or four.
+  static glm::vec4 SplitScreenViewport(int index, int count, const glm::vec2& screen_size);
+
+  // Sets the uniforms of the program, that has to be in use, and enables
+  // the clip distances.
+  void Bind(gl::Program& prog) const;
+  void Unbind() const;
+
+private:
+  glm::mat4 view_projs_[kMaxViews];
+  glm::vec4 ndc_rects_[kMaxViews];  // (offset, scale)
+  int view_count_ = 0;
+};
+
+#endif
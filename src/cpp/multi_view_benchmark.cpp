@@ -0,0 +1,171 @@
+// Copyright (c), Tamas Csala
+
+// Renders a grid of spheres from 1 to 4 cameras in split-screen, once by
+// resubmitting the scene for every view, and once in a single pass with
+// MultiView, and reports the draw calls, the CPU time spent on submitting
+// them and the GPU time of the frame.
+
+#include "oglwrap_example.hpp"
+#include "multi_view.hpp"
+#include "vertex_format.hpp"
+#include "shader_permutation.hpp"
+#include "benchmark_util.hpp"
+
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+class MultiViewBenchmark : public OglwrapExample {
+private:
+  static constexpr int kGridSize = 32;
+  static constexpr int kSlices = 24;
+  static constexpr int kStacks = 12;
+  static constexpr int kTimedFramesPerStep = 100;
+  // Every view count is measured with both methods
+  static constexpr int kStepCount = 2 * MultiView::kMaxViews;
+
+  enum AttributeLocation { kPosition, kNormal };
+
+  gl::VertexArray vao_;
+  gl::ArrayBuffer buffer_;
+  VertexFormat vertex_format_;
+  GLsizei vertex_count_ = 0;
+
+  ShaderPermutations shaders_;
+  gl::Program& single_view_prog_;
+  gl::Program& multi_view_prog_;
+  MultiView multi_view_;
+
+  std::vector<glm::mat4> model_mats_;
+  BenchmarkSteps steps_;
+
+public:
+  MultiViewBenchmark ()
+    : shaders_(GetProjectDir() + "/src/glsl/lighting.vert",
+               GetProjectDir() + "/src/glsl/lighting.frag",
+               [](gl::Program& prog) {
+                 (prog | "inPos").bindLocation(kPosition);
+                 (prog | "inNormal").bindLocation(kNormal);
+               })
+    , single_view_prog_(shaders_.Get(MakePermutationKey()))
+    , multi_view_prog_(shaders_.Get(MakePermutationKey(kShaderMultiView)))
+    , steps_(window_, kStepCount, kTimedFramesPerStep) {
+    UploadSphere();
+
+    for (int z = 0; z < kGridSize; ++z) {
+      for (int x = 0; x < kGridSize; ++x) {
+        glm::vec3 pos = glm::vec3{x - (kGridSize - 1) / 2.0f, 0, z - (kGridSize - 1) / 2.0f};
+        model_mats_.push_back(glm::translate(glm::mat4{1.0f}, pos));
+      }
+    }
+
+    for (gl::Program* prog : {&single_view_prog_, &multi_view_prog_}) {
+      gl::Use(*prog);
+      SetDefaultLightingUniforms(*prog);
+      gl::Uniform<glm::vec3>(*prog, "color") = glm::vec3{0.7, 0.5, 0.3};
+      gl::Unuse(*prog);
+    }
+
+    gl::Enable(gl::kDepthTest);
+    gl::ClearColor(0.1f, 0.2f, 0.3f, 1.0f);
+
+    std::cout << kGridSize * kGridSize << " spheres, " << vertex_count_ << " vertices each, "
+              << kTimedFramesPerStep << " timed frames per step" << std::endl;
+  }
+
+private:
+  void UploadSphere() {
+    std::vector<glm::vec3> positions, normals;
+    BuildSphere(kSlices, kStacks, glm::vec3{0.0f}, 0.4f, &positions, &normals);
+    vertex_count_ = positions.size();
+
+    gl::Bind(vao_);
+    gl::Bind(buffer_);
+    buffer_.data(vertex_format_.Pack(positions, normals));
+    vertex_format_.SetupAttribs(kPosition, kNormal);
+    gl::Unbind(buffer_);
+    gl::Unbind(vao_);
+  }
+
+  glm::mat4 ViewProjection(int view, const glm::vec4& viewport) const {
+    float angle = 2*M_PI * view / MultiView::kMaxViews;
+    glm::mat4 camera_mat = glm::lookAt(0.6f * kGridSize * glm::vec3{cos(angle), 0.8f, sin(angle)},
+                                       glm::vec3{0.0f, 0.0f, 0.0f},
+                                       glm::vec3{0.0f, 1.0f, 0.0f});
+    glm::mat4 proj_mat = glm::perspectiveFov<float>(M_PI/3.0, viewport.z, viewport.w, 0.1, 100);
+    return proj_mat * camera_mat;
+  }
+
+  // The step's configuration: first a pass per view, then a single pass
+  int measured_view_count() const { return steps_.step() / 2 + 1; }
+  bool single_pass_step() const { return steps_.step() % 2 == 1; }
+
+  // Traverses the scene once per view.
+  void RenderPerView() {
+    glm::vec2 screen_size{kScreenWidth, kScreenHeight};
+    gl::Use(single_view_prog_);
+    gl::Bind(vao_);
+    for (int view = 0; view < measured_view_count(); ++view) {
+      glm::vec4 viewport = MultiView::SplitScreenViewport(view, measured_view_count(), screen_size);
+      glViewport(viewport.x, viewport.y, viewport.z, viewport.w);
+      glm::mat4 view_proj = ViewProjection(view, viewport);
+
+      for (const glm::mat4& model_mat : model_mats_) {
+        gl::Uniform<glm::mat4>(single_view_prog_, "mvp") = view_proj * model_mat;
+        gl::Uniform<glm::mat4>(single_view_prog_, "model_mat") = model_mat;
+        glDrawArrays(GL_TRIANGLES, 0, vertex_count_);
+      }
+    }
+    glViewport(0, 0, kScreenWidth, kScreenHeight);
+    gl::Unbind(vao_);
+    gl::Unuse(single_view_prog_);
+  }
+
+  // Traverses the scene once, every draw call covers all the views.
+  void RenderSinglePass() {
+    glm::vec2 screen_size{kScreenWidth, kScreenHeight};
+    multi_view_.Clear();
+    for (int view = 0; view < measured_view_count(); ++view) {
+      glm::vec4 viewport = MultiView::SplitScreenViewport(view, measured_view_count(), screen_size);
+      multi_view_.AddView(ViewProjection(view, viewport), viewport, screen_size);
+    }
+
+    gl::Use(multi_view_prog_);
+    multi_view_.Bind(multi_view_prog_);
+    gl::Bind(vao_);
+    for (const glm::mat4& model_mat : model_mats_) {
+      gl::Uniform<glm::mat4>(multi_view_prog_, "model_mat") = model_mat;
+      glDrawArraysInstanced(GL_TRIANGLES, 0, vertex_count_, multi_view_.instance_count());
+    }
+    gl::Unbind(vao_);
+    multi_view_.Unbind();
+    gl::Unuse(multi_view_prog_);
+  }
+
+protected:
+  virtual void Render() override {
+    int view_count = measured_view_count();
+    bool single_pass = single_pass_step();
+
+    steps_.BeginFrame();
+    if (single_pass) {
+      RenderSinglePass();
+    } else {
+      RenderPerView();
+    }
+
+    if (steps_.EndFrame()) {
+      size_t draw_calls = model_mats_.size() * (single_pass ? 1 : view_count);
+      std::cout << "  " << view_count << (view_count == 1 ? " view, " : " views, ")
+                << (single_pass ? "single pass: " : "pass per view: ")
+                << draw_calls << " draw calls, "
+                << steps_.average_cpu_ms() << " ms CPU, "
+                << steps_.average_gpu_ms() << " ms GPU" << std::endl;
+    }
+  }
+};
+
+int main(int argc, char* argv[]) {
+  MultiViewBenchmark benchmark;
+  benchmark.ParseCommandLine(argc, argv);
+  benchmark.RunMainLoop();
+}
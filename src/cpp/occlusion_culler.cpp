@@ -0,0 +1,204 @@
+// Copyright (c), Tamas Csala
+
+#include "occlusion_culler.hpp"
+
+#include <algorithm>
+
+constexpr int OcclusionCuller::kRingSize;
+constexpr size_t OcclusionCuller::kConditionalBatchSize;
+
+OcclusionCuller::OcclusionCuller(size_t object_count, Mode mode)
+    : mode_(mode)
+    , object_count_(object_count)
+    , cube_({gl::CubeShape::kPosition})
+    , queries_(kRingSize * object_count)
+    , visible_(object_count, true)
+    , samples_queries_(object_count) {
+  gl::ShaderSource vs_source;
+  vs_source.set_source(R"""(
+    #version 330 core
+    in vec4 inPos;
+
+    uniform mat4 mvp;
+
+    void main() {
+      gl_Position = mvp * inPos;
+    })""");
+  vs_source.set_source_file("occlusion_proxy.vert");
+  gl::Shader vs(gl::kVertexShader, vs_source);
+
+  gl::ShaderSource fs_source;
+  fs_source.set_source(R"""(
+    #version 330 core
+    out vec4 fragColor;
+
+    void main() {
+      fragColor = vec4(1.0);
+    })""");
+  fs_source.set_source_file("occlusion_proxy.frag");
+  gl::Shader fs(gl::kFragmentShader, fs_source);
+
+  prog_.attachShader(vs);
+  prog_.attachShader(fs);
+  (prog_ | "inPos").bindLocation(gl::CubeShape::kPosition);
+  prog_.link();
+
+  if (object_count > 0) {
+    glGenQueries(queries_.size(), queries_.data());
+    glGenQueries(samples_queries_.size(), samples_queries_.data());
+  }
+}
+
+OcclusionCuller::~OcclusionCuller() {
+  if (object_count_ > 0) {
+    glDeleteQueries(queries_.size(), queries_.data());
+    glDeleteQueries(samples_queries_.size(), samples_queries_.data());
+  }
+}
+
+void OcclusionCuller::set_mode(Mode mode) {
+  mode_ = mode;
+  // The old results might be stale, so start from "everything is visible"
+  std::fill(visible_.begin(), visible_.end(), true);
+}
+
+void OcclusionCuller::CollectResults() {
+  // Go from the oldest query set to the newest, so newer results win
+  for (int i = 1; i <= kRingSize; ++i) {
+    int slot = (current_slot_ + i) % kRingSize;
+    if (!slot_pending_[slot]) {
+      continue;
+    }
+
+    // The queries of a slot finish in the order they were issued,
+    // so if the last one is available, all of them are.
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(query(slot, object_count_ - 1), GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      // The newer slots can't be ready either
+      break;
+    }
+
+    for (size_t object = 0; object < object_count_; ++object) {
+      GLuint any_samples_passed = GL_TRUE;
+      glGetQueryObjectuiv(query(slot, object), GL_QUERY_RESULT, &any_samples_passed);
+      visible_[object] = any_samples_passed != GL_FALSE;
+    }
+    slot_pending_[slot] = false;
+  }
+}
+
+void OcclusionCuller::BeginProxies() {
+  gl::Use(prog_);
+  // The caller's state is restored by EndProxies()
+  glGetBooleanv(GL_COLOR_WRITEMASK, saved_color_mask_);
+  glGetBooleanv(GL_DEPTH_WRITEMASK, &saved_depth_mask_);
+  glGetIntegerv(GL_DEPTH_FUNC, &saved_depth_func_);
+  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  gl::DepthMask(false);
+  // A proxy can coincide with the surface of the object it bounds
+  glDepthFunc(GL_LEQUAL);
+}
+
+void OcclusionCuller::EndProxies() {
+  glDepthFunc(static_cast<GLenum>(saved_depth_func_));
+  glDepthMask(saved_depth_mask_);
+  glColorMask(saved_color_mask_[0], saved_color_mask_[1],
+              saved_color_mask_[2], saved_color_mask_[3]);
+  gl::Unuse(prog_);
+}
+
+void OcclusionCuller::DrawProxy(GLuint proxy_query, const glm::mat4& mvp) {
+  gl::Uniform<glm::mat4>(prog_, "mvp") = mvp;
+  glBeginQuery(GL_ANY_SAMPLES_PASSED, proxy_query);
+  cube_.render();
+  glEndQuery(GL_ANY_SAMPLES_PASSED);
+}
+
+void OcclusionCuller::DrawObject(size_t object, const std::function<void(size_t)>& draw) {
+  if (count_samples_) {
+    glBeginQuery(GL_SAMPLES_PASSED, samples_queries_[object]);
+    draw(object);
+    glEndQuery(GL_SAMPLES_PASSED);
+  } else {
+    draw(object);
+  }
+}
+
+void OcclusionCuller::Render(const std::function<glm::mat4(size_t)>& proxy_mvp,
+                             const std::function<void(size_t)>& draw,
+                             FrameArena* scratch) {
+  FrameVector<bool> drawn(count_samples_ ? object_count_ : 0, true,
+                          FrameAllocator<bool>{scratch});
+  culled_count_ = 0;
+
+  switch (mode_) {
+    case Mode::kDisabled: {
+      for (size_t object = 0; object < object_count_; ++object) {
+        DrawObject(object, draw);
+      }
+    } break;
+
+    case Mode::kPreviousFrame: {
+      CollectResults();
+
+      for (size_t object = 0; object < object_count_; ++object) {
+        if (visible_[object]) {
+          DrawObject(object, draw);
+        } else {
+          culled_count_++;
+          if (count_samples_) {
+            drawn[object] = false;
+          }
+        }
+      }
+
+      // If every query set is still in flight, skip querying in this
+      // frame, rather than waiting for the oldest one.
+      int next_slot = (current_slot_ + 1) % kRingSize;
+      if (object_count_ > 0 && !slot_pending_[next_slot]) {
+        BeginProxies();
+        for (size_t object = 0; object < object_count_; ++object) {
+          DrawProxy(query(next_slot, object), proxy_mvp(object));
+        }
+        EndProxies();
+        slot_pending_[next_slot] = true;
+        current_slot_ = next_slot;
+      }
+    } break;
+
+    case Mode::kConditionalRender: {
+      // The proxies of a batch go first, so the state is only switched once per
+      // batch, while the objects of the later batches can still be hidden by
+      // the ones drawn before them.
+      for (size_t first = 0; first < object_count_; first += kConditionalBatchSize) {
+        size_t last = std::min(first + kConditionalBatchSize, object_count_);
+
+        BeginProxies();
+        for (size_t object = first; object < last; ++object) {
+          DrawProxy(query(0, object), proxy_mvp(object));
+        }
+        EndProxies();
+
+        // The GPU waits for the results (the CPU doesn't). With NO_WAIT, the
+        // objects would nearly always be drawn, as the results are rarely ready.
+        for (size_t object = first; object < last; ++object) {
+          glBeginConditionalRender(query(0, object), GL_QUERY_WAIT);
+          DrawObject(object, draw);
+          glEndConditionalRender();
+        }
+      }
+    } break;
+  }
+
+  if (count_samples_) {
+    samples_passed_ = 0;
+    for (size_t object = 0; object < object_count_; ++object) {
+      if (drawn[object]) {
+        GLuint64 samples = 0;
+        glGetQueryObjectui64v(samples_queries_[object], GL_QUERY_RESULT, &samples);
+        samples_passed_ += samples;
+      }
+    }
+  }
+}
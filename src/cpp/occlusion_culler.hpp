@@ -0,0 +1,106 @@
+// Copyright (c), Tamas Csala
+
+#ifndef OCCLUSION_CULLER_HPP_
+#define OCCLUSION_CULLER_HPP_
+
+#include <vector>
+#include <functional>
+#include <glad/glad.h>
+#include <oglwrap/oglwrap.h>
+#include <oglwrap/shapes/cube_shape.h>
+#include <glm/glm.hpp>
+
+#include "frame_arena.hpp"
+
+// Skips drawing the objects that are hidden behind others, using hardware
+// occlusion queries on cheap bounding box proxies (a unit cube, transformed
+// by a per object matrix). The proxies are drawn without color and depth
+// writes, so they only test against what has been drawn already.
+class OcclusionCuller {
+public:
+  enum class Mode {
+    // Draws everything, for comparison
+    kDisabled,
+
+    // Draws the objects that were visible according to the latest available
+    // query results, then queries the proxies of every object against the
+    // result. The results are read back a few frames later, from a ring of
+    // query sets, only when they are already available, so the CPU never
+    // waits for the GPU. Objects that become visible appear with that latency.
+    kPreviousFrame,
+
+    // Queries the proxies of a batch of objects, then wraps each of their
+    // draws in a conditional render, so the GPU skips the ones whose proxy was
+    // hidden. Nothing is read back, and the result doesn't depend on timing,
+    // but the objects should come in front-to-back order.
+    kConditionalRender
+  };
+
+  // The number of frames the query results can lag behind.
+  static constexpr int kRingSize = 3;
+
+  // The number of proxies drawn together in kConditionalRender mode.
+  static constexpr size_t kConditionalBatchSize = 64;
+
+  OcclusionCuller(size_t object_count, Mode mode = Mode::kPreviousFrame);
+  ~OcclusionCuller();
+
+  OcclusionCuller(const OcclusionCuller&) = delete;
+  OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+  Mode mode() const { return mode_; }
+  void set_mode(Mode mode);
+
+  // Renders 'object_count' objects. 'proxy_mvp' returns the transformation of
+  // the unit cube that bounds the object, 'draw' renders the object itself.
+  // As the proxies use their own program, 'draw' has to use its own.
+  // The per frame bookkeeping is allocated from 'scratch', if it's given.
+  void Render(const std::function<glm::mat4(size_t)>& proxy_mvp,
+              const std::function<void(size_t)>& draw,
+              FrameArena* scratch = nullptr);
+
+  // When enabled, every real draw is wrapped into a GL_SAMPLES_PASSED query,
+  // and the results are summed up (with a CPU-GPU sync at the end of the
+  // frame). Only meant for benchmarking.
+  void set_count_samples(bool count_samples) { count_samples_ = count_samples; }
+  GLuint64 samples_passed() const { return samples_passed_; }
+
+  // The number of objects that weren't drawn in the last frame. Always zero
+  // in kConditionalRender mode, as only the GPU knows that.
+  size_t culled_count() const { return culled_count_; }
+
+private:
+  Mode mode_;
+  size_t object_count_;
+
+  gl::CubeShape cube_;
+  gl::Program prog_;
+
+  // kRingSize sets of object_count_ queries
+  std::vector<GLuint> queries_;
+  bool slot_pending_[kRingSize] = {};
+  int current_slot_ = 0;
+
+  // The latest known visibility of each object
+  std::vector<bool> visible_;
+
+  // One GL_SAMPLES_PASSED query per object, see set_count_samples()
+  std::vector<GLuint> samples_queries_;
+  bool count_samples_ = false;
+  // The state that the proxies change, saved by BeginProxies()
+  GLint saved_depth_func_ = GL_LESS;
+  GLboolean saved_depth_mask_ = GL_TRUE;
+  GLboolean saved_color_mask_[4] = {GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE};
+  GLuint64 samples_passed_ = 0;
+  size_t culled_count_ = 0;
+
+  GLuint query(int slot, size_t object) const { return queries_[slot*object_count_ + object]; }
+
+  void CollectResults();
+  void BeginProxies();
+  void EndProxies();
+  void DrawProxy(GLuint proxy_query, const glm::mat4& mvp);
+  void DrawObject(size_t object, const std::function<void(size_t)>& draw);
+};
+
+#endif
@@ -0,0 +1,128 @@
+// Copyright (c), Tamas Csala
+
+// Renders a dense lattice of spheres, where most of them are hidden by the
+// front layers, with each OcclusionCuller mode, and reports the CPU and GPU
+// time of the frame, the number of samples that passed the depth test and
+// the culled objects.
+
+#include "oglwrap_example.hpp"
+#include "occlusion_culler.hpp"
+#include "shader_permutation.hpp"
+#include "benchmark_util.hpp"
+
+#include <cmath>
+#include <oglwrap/shapes/sphere_shape.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+class OcclusionCullingBenchmark : public OglwrapExample {
+private:
+  static constexpr int kLatticeSize = 16;
+  static constexpr int kObjectCount = kLatticeSize * kLatticeSize * kLatticeSize;
+  static constexpr int kTimedFramesPerMode = 100;
+
+  gl::SphereShape sphere_shape_;
+  ShaderPermutations shaders_;
+  gl::Program& prog_;
+  OcclusionCuller culler_;
+
+  glm::mat4 view_proj_;
+  std::vector<glm::mat4> mvps_;
+
+  // Every mode is a step. The samples are counted in the last warmup frame,
+  // as counting them waits for the queries.
+  static constexpr OcclusionCuller::Mode kModes[] = {
+    OcclusionCuller::Mode::kDisabled,
+    OcclusionCuller::Mode::kPreviousFrame,
+    OcclusionCuller::Mode::kConditionalRender
+  };
+  static constexpr const char* kModeNames[] = {
+    "disabled", "previous frame results", "conditional render"
+  };
+  static constexpr int kModeCount = sizeof(kModes) / sizeof(kModes[0]);
+  BenchmarkSteps steps_;
+  GLuint64 samples_passed_ = 0;
+
+public:
+  OcclusionCullingBenchmark ()
+    : sphere_shape_({gl::SphereShape::kPosition,
+                     gl::SphereShape::kNormal})
+    , shaders_(GetProjectDir() + "/src/glsl/lighting.vert",
+               GetProjectDir() + "/src/glsl/lighting.frag",
+               [](gl::Program& prog) {
+                 (prog | "inPos").bindLocation(gl::SphereShape::kPosition);
+                 (prog | "inNormal").bindLocation(gl::SphereShape::kNormal);
+               })
+    , prog_(shaders_.Get(MakePermutationKey()))
+    , culler_(kObjectCount, kModes[0])
+    , steps_(window_, kModeCount, kTimedFramesPerMode)
+  {
+    glm::mat4 camera_mat = glm::lookAt(glm::vec3{0.0f, 0.0f, kLatticeSize},
+                                       glm::vec3{0.0f, 0.0f, 0.0f},
+                                       glm::vec3{0.0f, 1.0f, 0.0f});
+    glm::mat4 proj_mat = glm::perspectiveFov<float>(M_PI/3.0, kScreenWidth, kScreenHeight, 0.1, 100);
+    view_proj_ = proj_mat * camera_mat;
+
+    // Ordered front to back: the camera looks towards -Z
+    for (int z = kLatticeSize - 1; z >= 0; --z) {
+      for (int y = 0; y < kLatticeSize; ++y) {
+        for (int x = 0; x < kLatticeSize; ++x) {
+          glm::vec3 pos = 1.05f * (glm::vec3{x, y, z} - glm::vec3{(kLatticeSize - 1) / 2.0f});
+          mvps_.push_back(view_proj_ * glm::translate(glm::mat4{1.0f}, pos));
+        }
+      }
+    }
+
+    gl::Use(prog_);
+    SetDefaultLightingUniforms(prog_);
+    gl::Uniform<glm::vec3>(prog_, "color") = glm::vec3{0.7, 0.5, 0.3};
+    gl::Unuse(prog_);
+
+    gl::Enable(gl::kDepthTest);
+    gl::ClearColor(0.1f, 0.2f, 0.3f, 1.0f);
+
+    std::cout << kObjectCount << " spheres, " << kTimedFramesPerMode
+              << " timed frames per mode" << std::endl;
+  }
+
+protected:
+  virtual void Render() override {
+    OcclusionCuller::Mode mode = kModes[steps_.step()];
+    if (culler_.mode() != mode) {
+      culler_.set_mode(mode);
+    }
+    bool counting = steps_.frame_in_step() == steps_.warmup_frames() - 1;
+    culler_.set_count_samples(counting);
+
+    steps_.BeginFrame();
+    culler_.Render(
+      [this](size_t i) { return mvps_[i]; },
+      [this](size_t i) {
+        gl::Use(prog_);
+        gl::Uniform<glm::mat4>(prog_, "mvp") = mvps_[i];
+        sphere_shape_.render();
+        gl::Unuse(prog_);
+      }, &frame_arena());
+    steps_.AddValue(culler_.culled_count());
+
+    if (counting) {
+      samples_passed_ = culler_.samples_passed();
+    }
+
+    if (steps_.EndFrame()) {
+      std::cout << "  " << kModeNames[steps_.step() - 1] << ": "
+                << steps_.average_cpu_ms() << " ms CPU, "
+                << steps_.average_gpu_ms() << " ms GPU, "
+                << samples_passed_ << " samples passed, "
+                << steps_.average_value() << " objects culled" << std::endl;
+    }
+  }
+};
+
+constexpr OcclusionCuller::Mode OcclusionCullingBenchmark::kModes[];
+constexpr const char* OcclusionCullingBenchmark::kModeNames[];
+
+int main(int argc, char* argv[]) {
+  OcclusionCullingBenchmark benchmark;
+  benchmark.ParseCommandLine(argc, argv);
+  benchmark.RunMainLoop();
+}
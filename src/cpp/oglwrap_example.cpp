@@ -1,11 +1,23 @@
 // Copyright (c), Tamas Csala
 
 #include "oglwrap_example.hpp"
+#include "shader_permutation.hpp"
+#include "allocation_counter.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+
+// The screen size is passed to glm constructors by reference
+constexpr int OglwrapExample::kScreenWidth;
+constexpr int OglwrapExample::kScreenHeight;
 
 OglwrapExample::OglwrapExample() {
   if (!glfwInit()) {
     std::terminate();
   }
+  startup_time_ = glfwGetTime();
 
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -32,14 +44,159 @@ OglwrapExample::~OglwrapExample() {
   glfwTerminate();
 }
 
+void OglwrapExample::ParseCommandLine(int argc, char* argv[]) {
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (!strcmp(argv[i], "--fixed-timestep") && has_value) {
+      char* end = nullptr;
+      double timestep = strtod(argv[++i], &end);
+      if (end == argv[i] || *end != '\0' || !(timestep > 0)) {
+        std::cerr << "The timestep has to be a positive number of seconds, got: "
+                  << argv[i] << std::endl;
+        std::terminate();
+      }
+      SetTimeSource(std::unique_ptr<TimeSource>{new FixedTimestepSource{timestep}});
+    } else if (!strcmp(argv[i], "--playback") && has_value) {
+      SetTimeSource(std::unique_ptr<TimeSource>{new PlaybackTimeSource{argv[++i]}});
+    } else if (!strcmp(argv[i], "--record") && has_value) {
+      time_recorder_.reset(new TimeRecorder{});
+      record_path_ = argv[++i];
+    } else if (!strcmp(argv[i], "--frame-costs") && has_value) {
+      frame_cost_recorder_.reset(new TimeRecorder{});
+      frame_costs_path_ = argv[++i];
+    } else if (!strcmp(argv[i], "--stats")) {
+      print_stats_ = true;
+    } else if (!strcmp(argv[i], "--camera-path") && has_value) {
+      camera_path_.reset(new CameraPath{argv[++i]});
+    } else if (!strcmp(argv[i], "--frames") && has_value) {
+      max_frames_ = atoll(argv[++i]);
+    } else if (!strcmp(argv[i], "--views") && has_value) {
+      view_count_ = atoi(argv[++i]);
+      if (view_count_ < 1 || MultiView::kMaxViews < view_count_) {
+        std::cerr << "The view count has to be between 1 and "
+                  << MultiView::kMaxViews << std::endl;
+        std::terminate();
+      }
+    } else {
+      std::cerr << "Unknown or incomplete option: " << argv[i] << std::endl;
+      std::terminate();
+    }
+  }
+}
+
+void OglwrapExample::SetTimeSource(std::unique_ptr<TimeSource> time_source) {
+  time_source_ = std::move(time_source);
+}
+
+glm::mat4 OglwrapExample::GetCameraMatrix(const glm::mat4& default_camera_mat) const {
+  if (camera_path_) {
+    return camera_path_->CameraMatrix(time_);
+  } else {
+    return default_camera_mat;
+  }
+}
+
+const MultiView& OglwrapExample::SetupViews(const glm::mat4& camera_mat, float fovy,
+                                            float z_near, float z_far) {
+  glm::vec2 screen_size{kScreenWidth, kScreenHeight};
+  multi_view_.Clear();
+  for (int view = 0; view < view_count_; ++view) {
+    glm::vec4 viewport = MultiView::SplitScreenViewport(view, view_count_, screen_size);
+    float angle = 2*M_PI * view / view_count_;
+    glm::mat4 view_mat = camera_mat * glm::rotate(glm::mat4{1.0f}, angle, glm::vec3{0, 1, 0});
+    glm::mat4 proj_mat = glm::perspectiveFov(fovy, viewport.z, viewport.w, z_near, z_far);
+    multi_view_.AddView(proj_mat * view_mat, viewport, screen_size);
+  }
+  return multi_view_;
+}
+
 void OglwrapExample::RunMainLoop() {
-  while (!glfwWindowShouldClose(window_)) {
+  if (!time_source_) {
+    time_source_.reset(new RealTimeSource{});
+  }
+
+  if (max_frames_ >= 0) {
+    // Don't let the recordings allocate during the frames
+    if (time_recorder_) {
+      time_recorder_->Reserve(max_frames_);
+    }
+    if (frame_cost_recorder_) {
+      frame_cost_recorder_->Reserve(max_frames_);
+    }
+  }
+
+  // The heap allocations of the render thread, the first few frames
+  // are expected to allocate while the caches and buffers warm up.
+  const long long kWarmupFrames = 10;
+  size_t first_frame_allocations = 0;
+  size_t steady_state_allocations = 0, max_steady_state_allocations = 0;
+
+  long long frame = 0;
+  while (!glfwWindowShouldClose(window_) && !time_source_->Finished() &&
+         (max_frames_ < 0 || frame < max_frames_)) {
+    size_t allocations_before = ThreadHeapAllocationCount();
+    frame_arena_.Reset();
+
+    double frame_start = glfwGetTime();
+    time_ = time_source_->NextFrame();
+    if (time_recorder_) {
+      time_recorder_->Record(time_);
+    }
+
     gl::Clear().Color().Depth();
 
     Render ();
 
     glfwSwapBuffers(window_);
     glfwPollEvents();
+    if (frame == 0 && print_stats_) {
+      std::cout << "Time to first frame: "
+                << 1000 * (glfwGetTime() - startup_time_) << " ms" << std::endl;
+    }
+
+    if (frame_cost_recorder_) {
+      frame_cost_recorder_->Record(glfwGetTime() - frame_start);
+    }
+
+    size_t allocations = ThreadHeapAllocationCount() - allocations_before;
+    if (frame == 0) {
+      first_frame_allocations = allocations;
+    } else if (frame >= kWarmupFrames) {
+      steady_state_allocations += allocations;
+      max_steady_state_allocations = std::max(max_steady_state_allocations, allocations);
+    }
+    frame++;
+  }
+
+  if (print_stats_) {
+    std::cout << "Frame arena high-water mark: " << frame_arena_.high_water_mark() / 1024.0
+              << " KiB, " << frame_arena_.overflow_count() << " overflowing allocations" << std::endl;
+    std::cout << "Heap allocations: " << first_frame_allocations << " in the first frame";
+    if (frame > kWarmupFrames) {
+      std::cout << ", " << steady_state_allocations << " in the " << frame - kWarmupFrames
+                << " frames after the first " << kWarmupFrames
+                << " (at most " << max_steady_state_allocations << " per frame)";
+    }
+    std::cout << std::endl;
+
+    if (ShaderPermutations::total_variant_count() > 0) {
+      ShaderPermutations::PrintStatistics(std::cout);
+    }
+  }
+
+  if (time_recorder_) {
+    time_recorder_->Save(record_path_);
+  }
+  if (frame_cost_recorder_) {
+    frame_cost_recorder_->Save(frame_costs_path_);
+  }
+}
+
+void OglwrapExample::ReportFullyLoaded() {
+  if (!fully_loaded_reported_ && print_stats_) {
+    std::cout << "Time to fully loaded: "
+              << 1000 * (glfwGetTime() - startup_time_) << " ms" << std::endl;
+    fully_loaded_reported_ = true;
   }
 }
 
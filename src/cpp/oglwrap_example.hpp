@@ -3,17 +3,39 @@
 #ifndef OGLWRAP_EXAMPLE_HPP_
 #define OGLWRAP_EXAMPLE_HPP_
 
+#include <memory>
 #include <string>
 #include <iostream>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <oglwrap/oglwrap.h>
+#include <glm/glm.hpp>
+
+#include "time_source.hpp"
+#include "camera_path.hpp"
+#include "frame_arena.hpp"
+#include "multi_view.hpp"
 
 class OglwrapExample {
 public:
   OglwrapExample();
   ~OglwrapExample();
 
+  // Understood options:
+  //   --fixed-timestep <seconds>  advance the time by the same amount every frame
+  //   --playback <file>           replay the frame times of a recorded run
+  //   --record <file>             save the frame times of this run
+  //   --frame-costs <file>        save how long each frame took (wall clock seconds)
+  //   --stats                     print the startup times, and the memory and
+  //                               shader statistics at exit
+  //   --camera-path <file>        move the camera along a scripted path
+  //   --frames <count>            exit after rendering this many frames
+  //   --views <count>             render 1-4 cameras in split-screen, in a single
+  //                               pass (only in the examples that use SetupViews)
+  void ParseCommandLine(int argc, char* argv[]);
+
+  void SetTimeSource(std::unique_ptr<TimeSource> time_source);
+
   void RunMainLoop();
 
 protected:
@@ -24,9 +46,57 @@ protected:
   virtual void Render() = 0;
 
   std::string GetProjectDir();
+
+  // The animation time of the current frame, in seconds. Use this
+  // instead of glfwGetTime().
+  double GetTime() const { return time_; }
+
+  // True with --fixed-timestep or --playback. The examples should then avoid
+  // anything that depends on the speed of the machine (like waiting for
+  // background loads or GPU queries to finish without blocking).
+  bool HasDeterministicTime() const {
+    return time_source_ && time_source_->deterministic();
+  }
+
+  // Returns the camera matrix from the camera path, if one was specified,
+  // otherwise returns the example's own camera matrix.
+  glm::mat4 GetCameraMatrix(const glm::mat4& default_camera_mat) const;
+
+  // Examples that load their assets in the background should call this once
+  // everything is ready, to print the time it took since startup (with --stats).
+  void ReportFullyLoaded();
+
+  // The number of views requested with --views, one by default.
+  int view_count() const { return view_count_; }
+
+  // Fills the views for this frame and returns them: view_count() cameras in
+  // split-screen, the i-th one orbiting the scene by i/view_count() of a full
+  // turn around the Y axis compared to camera_mat. The aspect ratio of the
+  // projections follows the views' viewports. The example has to draw with
+  // the MULTI_VIEW shader variant, and with views.instance_count() instances.
+  const MultiView& SetupViews(const glm::mat4& camera_mat, float fovy,
+                              float z_near, float z_far);
+
+  // Scratch memory for data that only lives until the end of the frame
+  // (see FrameAllocator). It is reset before every Render() call, so it can
+  // also be used for temporaries in the constructors.
+  FrameArena& frame_arena() { return frame_arena_; }
+
+private:
+  FrameArena frame_arena_;
+  MultiView multi_view_;
+  int view_count_ = 1;
+  std::unique_ptr<TimeSource> time_source_;
+  std::unique_ptr<CameraPath> camera_path_;
+  std::unique_ptr<TimeRecorder> time_recorder_, frame_cost_recorder_;
+  std::string record_path_, frame_costs_path_;
+  long long max_frames_ = -1;
+  bool print_stats_ = false;
+  double time_ = 0.0;
+  double startup_time_ = 0.0;
+  bool fully_loaded_reported_ = false;
 };
 
 
 #endif
 
-
@@ -0,0 +1,142 @@
+// Copyright (c), Tamas Csala
+
+#include "shader_permutation.hpp"
+
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <glm/glm.hpp>
+
+size_t ShaderPermutations::total_variant_count_ = 0;
+double ShaderPermutations::total_compile_time_ms_ = 0.0;
+
+// AssetLoader records its variants from its GL thread
+static std::mutex statistics_mutex;
+
+std::string ShaderPermutations::ReadSource(const std::string& path) {
+  std::ifstream file(path);
+  if (!file) {
+    std::cerr << "Couldn't open shader file: " << path << std::endl;
+    throw std::runtime_error("Couldn't open shader file");
+  }
+
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return buffer.str();
+}
+
+ShaderPermutations::ShaderPermutations(const std::string& vs_path,
+                                       const std::string& fs_path,
+                                       std::function<void(gl::Program&)> bind_attributes)
+    : vs_path_(vs_path), fs_path_(fs_path)
+    , vs_source_(ReadSource(vs_path)), fs_source_(ReadSource(fs_path))
+    , bind_attributes_(bind_attributes) {}
+
+std::string ShaderPermutations::Defines(ShaderPermutationKey key) {
+  std::string defines;
+  if (key & kShaderShadows) {
+    defines += "#define SHADOWS\n";
+  }
+  if (key & kShaderSrgbOutput) {
+    defines += "#define SRGB_OUTPUT\n";
+  }
+  if (key & kShaderInstancing) {
+    defines += "#define INSTANCING\n";
+  }
+  if (key & kShaderQuantizedPositions) {
+    defines += "#define QUANTIZED_POSITIONS\n";
+  }
+  if (key & kShaderClusteredLights) {
+    defines += "#define CLUSTERED_LIGHTS\n";
+  }
+  if (key & kShaderMultiView) {
+    defines += "#define MULTI_VIEW\n";
+  }
+  unsigned pcf_half_size = (key & kShaderPcfKernelMask) >> kShaderPcfKernelShift;
+  if (pcf_half_size) {
+    defines += "#define PCF_KERNEL_SIZE " + std::to_string(2*pcf_half_size + 1) + "\n";
+  }
+  return defines;
+}
+
+std::string ShaderPermutations::Preprocess(const std::string& source,
+                                           ShaderPermutationKey key) {
+  // The #version directive must stay the first one
+  size_t version = source.find("#version");
+  size_t insert_pos = 0;
+  if (version != std::string::npos) {
+    insert_pos = source.find('\n', version);
+    insert_pos = (insert_pos == std::string::npos) ? source.size() : insert_pos + 1;
+  }
+
+  // Keep the line numbers of the compiler's messages matching the file
+  int next_line = std::count(source.begin(), source.begin() + insert_pos, '\n') + 1;
+  std::string injected = Defines(key) + "#line " + std::to_string(next_line) + "\n";
+
+  return source.substr(0, insert_pos) + injected + source.substr(insert_pos);
+}
+
+gl::Program& ShaderPermutations::Get(ShaderPermutationKey key) {
+  auto iter = variants_.find(key);
+  if (iter != variants_.end()) {
+    return *iter->second;
+  }
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  gl::ShaderSource vs_source;
+  vs_source.set_source(Preprocess(vs_source_, key));
+  vs_source.set_source_file(vs_path_);
+  gl::Shader vs(gl::kVertexShader, vs_source);
+
+  gl::ShaderSource fs_source;
+  fs_source.set_source(Preprocess(fs_source_, key));
+  fs_source.set_source_file(fs_path_);
+  gl::Shader fs(gl::kFragmentShader, fs_source);
+
+  std::unique_ptr<gl::Program> prog{new gl::Program{}};
+  prog->attachShader(vs);
+  prog->attachShader(fs);
+  if (bind_attributes_) {
+    bind_attributes_(*prog);
+  }
+  prog->link();
+
+  RecordVariant(std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - start).count());
+
+  gl::Program& result = *prog;
+  variants_[key] = std::move(prog);
+  return result;
+}
+
+void ShaderPermutations::RecordVariant(double compile_time_ms) {
+  std::lock_guard<std::mutex> lock{statistics_mutex};
+  total_variant_count_++;
+  total_compile_time_ms_ += compile_time_ms;
+}
+
+size_t ShaderPermutations::total_variant_count() {
+  std::lock_guard<std::mutex> lock{statistics_mutex};
+  return total_variant_count_;
+}
+
+double ShaderPermutations::total_compile_time_ms() {
+  std::lock_guard<std::mutex> lock{statistics_mutex};
+  return total_compile_time_ms_;
+}
+
+void ShaderPermutations::PrintStatistics(std::ostream& os) {
+  std::lock_guard<std::mutex> lock{statistics_mutex};
+  os << "Shader variants compiled: " << total_variant_count_
+     << " (" << total_compile_time_ms_ << " ms)" << std::endl;
+}
+
+void SetDefaultLightingUniforms(gl::Program& prog) {
+  gl::Uniform<glm::vec3>(prog, "lightPos") = normalize(glm::vec3{0.3, 1, 0.2});
+  gl::Uniform<float>(prog, "ambient") = 0.1f;
+}
@@ -0,0 +1,104 @@
+// Copyright (c), Tamas Csala
+
+#ifndef SHADER_PERMUTATION_HPP_
+#define SHADER_PERMUTATION_HPP_
+
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <functional>
+#include <unordered_map>
+#include <oglwrap/oglwrap.h>
+
+// The optional features of a shader. Each of them is turned into a #define
+// that is injected after the #version line, so every combination compiles
+// to a separate, branch-free program.
+enum ShaderFeature : uint32_t {
+  kShaderShadows            = 1 << 0,  // SHADOWS
+  kShaderSrgbOutput         = 1 << 1,  // SRGB_OUTPUT
+  kShaderInstancing         = 1 << 2,  // INSTANCING
+  kShaderQuantizedPositions = 1 << 3,  // QUANTIZED_POSITIONS (see VertexFormat)
+  kShaderClusteredLights    = 1 << 4,  // CLUSTERED_LIGHTS (see ClusteredLights)
+  kShaderMultiView          = 1 << 5,  // MULTI_VIEW (see MultiView)
+
+  // Bits 8-11 store the PCF kernel size (PCF_KERNEL_SIZE), see PcfKernel()
+  kShaderPcfKernelShift     = 8,
+  kShaderPcfKernelMask      = 0xF << kShaderPcfKernelShift
+};
+
+using ShaderPermutationKey = uint32_t;
+
+// The feature bits of a PCF kernel of size x size texels. The size has to be
+// odd, between 1 and 31 (the 4 bits store size / 2). Anything else throws,
+// which fails to compile when the key is a constant expression.
+constexpr ShaderPermutationKey PcfKernel(unsigned size) {
+  return (size % 2 == 1 && size <= 31)
+      ? (size / 2) << kShaderPcfKernelShift
+      : throw std::invalid_argument("The PCF kernel size has to be odd, at most 31");
+}
+
+// Combines features into a key, usable in constant expressions:
+//   constexpr ShaderPermutationKey kKey = MakePermutationKey(kShaderShadows, PcfKernel(3));
+constexpr ShaderPermutationKey MakePermutationKey() {
+  return 0;
+}
+
+template<typename... Rest>
+constexpr ShaderPermutationKey MakePermutationKey(ShaderPermutationKey first, Rest... rest) {
+  return first | MakePermutationKey(rest...);
+}
+
+// Compiles the variants of one vertex + fragment shader pair on demand,
+// and caches them, so that each requested combination is compiled only once.
+class ShaderPermutations {
+public:
+  // The sources are read once, here. 'bind_attributes' is called for every
+  // variant, before linking.
+  ShaderPermutations(const std::string& vs_path, const std::string& fs_path,
+                     std::function<void(gl::Program&)> bind_attributes = nullptr);
+
+  // Returns the variant for the key, compiling it if it isn't cached yet.
+  // The returned reference stays valid as long as this object lives.
+  gl::Program& Get(ShaderPermutationKey key);
+
+  // Compiles a variant ahead of time, so the first frame doesn't have to.
+  void Precompile(ShaderPermutationKey key) { Get(key); }
+
+  size_t variant_count() const { return variants_.size(); }
+
+  // The #define lines for the key, without the #version line.
+  static std::string Defines(ShaderPermutationKey key);
+
+  // Injects the defines of the key after the #version line of the source.
+  static std::string Preprocess(const std::string& source, ShaderPermutationKey key);
+
+  // Reads a shader file, throws std::runtime_error on failure.
+  static std::string ReadSource(const std::string& path);
+
+  // The number of variants compiled by all instances (and by
+  // AssetLoader::LoadPermutation), and the time spent on compiling and
+  // linking them. Thread safe.
+  static size_t total_variant_count();
+  static double total_compile_time_ms();
+  static void PrintStatistics(std::ostream& os);
+
+  // Adds a variant that was compiled outside of Get() to the statistics.
+  static void RecordVariant(double compile_time_ms);
+
+private:
+  std::string vs_path_, fs_path_;
+  std::string vs_source_, fs_source_;
+  std::function<void(gl::Program&)> bind_attributes_;
+  std::unordered_map<ShaderPermutationKey, std::unique_ptr<gl::Program>> variants_;
+
+  static size_t total_variant_count_;
+  static double total_compile_time_ms_;
+};
+
+// Sets the lighting.frag uniforms that most examples share: the direction of
+// the light (from above) and the ambient term. The program has to be in use.
+void SetDefaultLightingUniforms(gl::Program& prog);
+
+#endif
@@ -0,0 +1,85 @@
+// Copyright (c), Tamas Csala
+
+#include "task_queue.hpp"
+
+void TaskQueue::Start(unsigned thread_count,
+                      std::function<void()> on_thread_start,
+                      std::function<void()> on_thread_exit) {
+  for (unsigned i = 0; i < thread_count; ++i) {
+    threads_.emplace_back([this, on_thread_start, on_thread_exit]() {
+      if (on_thread_start) {
+        on_thread_start();
+      }
+
+      while (true) {
+        std::function<void()> task;
+        {
+          std::unique_lock<std::mutex> lock{mutex_};
+          task_available_.wait(lock, [this]() {
+            return stopping_ || next_task_ < tasks_.size();
+          });
+          if (stopping_) {
+            break;
+          }
+          task = std::move(tasks_[next_task_++]);
+          // Reuse the storage once everything has been taken
+          if (next_task_ == tasks_.size()) {
+            tasks_.clear();
+            next_task_ = 0;
+          }
+        }
+
+        task();
+
+        {
+          std::lock_guard<std::mutex> lock{mutex_};
+          if (--unfinished_count_ == 0) {
+            all_finished_.notify_all();
+          }
+        }
+      }
+
+      if (on_thread_exit) {
+        on_thread_exit();
+      }
+    });
+  }
+}
+
+void TaskQueue::Push(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (stopping_) {
+      return;
+    }
+    tasks_.push_back(std::move(task));
+    unfinished_count_++;
+  }
+  task_available_.notify_one();
+}
+
+void TaskQueue::Reserve(size_t task_count) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  tasks_.reserve(task_count);
+}
+
+void TaskQueue::Wait() {
+  std::unique_lock<std::mutex> lock{mutex_};
+  all_finished_.wait(lock, [this]() { return stopping_ || unfinished_count_ == 0; });
+}
+
+void TaskQueue::Stop() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stopping_ = true;
+    unfinished_count_ -= tasks_.size() - next_task_;
+    tasks_.clear();
+    next_task_ = 0;
+  }
+  task_available_.notify_all();
+  all_finished_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+}
@@ -0,0 +1,52 @@
+// Copyright (c), Tamas Csala
+
+#ifndef TASK_QUEUE_HPP_
+#define TASK_QUEUE_HPP_
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+// A set of threads that execute tasks in FIFO order.
+//
+// The queue keeps its storage once it has been emptied, so pushing small
+// tasks (whose captures fit into std::function without allocating, like a
+// pointer and an index) doesn't touch the heap in a steady state.
+class TaskQueue {
+public:
+  TaskQueue() = default;
+  ~TaskQueue() { Stop(); }
+
+  TaskQueue(const TaskQueue&) = delete;
+  TaskQueue& operator=(const TaskQueue&) = delete;
+
+  void Start(unsigned thread_count,
+             std::function<void()> on_thread_start = nullptr,
+             std::function<void()> on_thread_exit = nullptr);
+  void Push(std::function<void()> task);
+
+  // Preallocates the storage for this many queued tasks.
+  void Reserve(size_t task_count);
+
+  // Blocks until every pushed task has finished.
+  void Wait();
+
+  // Discards the tasks that haven't started yet, and joins the threads.
+  void Stop();
+
+  size_t thread_count() const { return threads_.size(); }
+
+private:
+  std::vector<std::thread> threads_;
+  std::vector<std::function<void()>> tasks_;
+  size_t next_task_ = 0;
+  size_t unfinished_count_ = 0;
+  std::mutex mutex_;
+  std::condition_variable task_available_;
+  std::condition_variable all_finished_;
+  bool stopping_ = false;
+};
+
+#endif
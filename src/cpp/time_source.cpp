@@ -0,0 +1,69 @@
+// Copyright (c), Tamas Csala
+
+#include "time_source.hpp"
+
+#include <limits>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <GLFW/glfw3.h>
+
+RealTimeSource::RealTimeSource()
+    : start_time_(glfwGetTime()) {}
+
+double RealTimeSource::NextFrame() {
+  return glfwGetTime() - start_time_;
+}
+
+FixedTimestepSource::FixedTimestepSource(double timestep)
+    : timestep_(timestep) {}
+
+double FixedTimestepSource::NextFrame() {
+  // Multiply instead of accumulating, so rounding errors don't add up.
+  return timestep_ * frame_++;
+}
+
+PlaybackTimeSource::PlaybackTimeSource(const std::string& path) {
+  std::ifstream file(path);
+  if (!file) {
+    std::cerr << "Couldn't open frame time recording: " << path << std::endl;
+    throw std::runtime_error("Couldn't open frame time recording");
+  }
+
+  double time;
+  while (file >> time) {
+    frame_times_.push_back(time);
+  }
+
+  if (frame_times_.empty()) {
+    std::cerr << "Empty frame time recording: " << path << std::endl;
+    throw std::runtime_error("Empty frame time recording");
+  }
+}
+
+double PlaybackTimeSource::NextFrame() {
+  if (frame_ < frame_times_.size()) {
+    return frame_times_[frame_++];
+  } else {
+    return frame_times_.back();
+  }
+}
+
+bool PlaybackTimeSource::Finished() const {
+  return frame_ >= frame_times_.size();
+}
+
+void TimeRecorder::Save(const std::string& path) const {
+  std::ofstream file(path);
+  if (!file) {
+    std::cerr << "Couldn't write frame time recording: " << path << std::endl;
+    return;
+  }
+
+  // Write every digit, so the playback is bit exact.
+  file << std::setprecision(std::numeric_limits<double>::max_digits10);
+  for (double time : frame_times_) {
+    file << time << '\n';
+  }
+}
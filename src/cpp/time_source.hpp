@@ -0,0 +1,76 @@
+// Copyright (c), Tamas Csala
+
+#ifndef TIME_SOURCE_HPP_
+#define TIME_SOURCE_HPP_
+
+#include <string>
+#include <vector>
+
+// Provides the animation time for each frame. The examples should never read
+// glfwGetTime() directly, so that a run can be made deterministic by swapping
+// the time source.
+class TimeSource {
+public:
+  virtual ~TimeSource() {}
+
+  // Advances to the next frame, and returns its time in seconds.
+  virtual double NextFrame() = 0;
+
+  // Returns true if the time source can't provide more frames.
+  virtual bool Finished() const { return false; }
+
+  // Returns true if the frame times don't depend on how fast the frames are
+  // rendered, so two runs should produce the same frames.
+  virtual bool deterministic() const { return false; }
+};
+
+// Wall clock time, this is the default.
+class RealTimeSource : public TimeSource {
+public:
+  RealTimeSource();
+  virtual double NextFrame() override;
+
+private:
+  double start_time_;
+};
+
+// Every frame advances the time by the same amount, regardless of how long
+// it took to render it.
+class FixedTimestepSource : public TimeSource {
+public:
+  explicit FixedTimestepSource(double timestep);
+  virtual double NextFrame() override;
+  virtual bool deterministic() const override { return true; }
+
+private:
+  double timestep_;
+  unsigned long long frame_ = 0;
+};
+
+// Replays the frame times of a previous run, that were written by
+// TimeRecorder. The file contains one time value (in seconds) per line.
+class PlaybackTimeSource : public TimeSource {
+public:
+  explicit PlaybackTimeSource(const std::string& path);
+  virtual double NextFrame() override;
+  virtual bool Finished() const override;
+  virtual bool deterministic() const override { return true; }
+
+private:
+  std::vector<double> frame_times_;
+  size_t frame_ = 0;
+};
+
+// Writes the frame times into a file, in the format that
+// PlaybackTimeSource reads.
+class TimeRecorder {
+public:
+  void Record(double time) { frame_times_.push_back(time); }
+  void Reserve(size_t frame_count) { frame_times_.reserve(frame_count); }
+  void Save(const std::string& path) const;
+
+private:
+  std::vector<double> frame_times_;
+};
+
+#endif
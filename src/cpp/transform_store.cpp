@@ -0,0 +1,229 @@
+// Copyright (c), Tamas Csala
+
+#include "transform_store.hpp"
+
+#include <cassert>
+#include <algorithm>
+#include <initializer_list>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+  #define TRANSFORM_STORE_USE_SSE 1
+  #include <xmmintrin.h>
+#else
+  #define TRANSFORM_STORE_USE_SSE 0
+#endif
+
+constexpr TransformStore::Handle TransformStore::kNoParent;
+
+void TransformStore::Reserve(size_t count) {
+  for (std::vector<float>* component : {&tx_, &ty_, &tz_, &qx_, &qy_, &qz_, &qw_,
+                                        &sx_, &sy_, &sz_}) {
+    component->reserve(count);
+  }
+  parents_.reserve(count);
+  dirty_.reserve(count);
+  world_matrices_.reserve(count);
+}
+
+TransformStore::Handle TransformStore::Add(const glm::vec3& translation,
+                                           const glm::quat& rotation,
+                                           const glm::vec3& scale,
+                                           Handle parent) {
+  Handle handle = static_cast<Handle>(parents_.size());
+  // Parents have to precede their children, see Update()
+  assert(parent == kNoParent || parent < handle);
+
+  tx_.push_back(translation.x);
+  ty_.push_back(translation.y);
+  tz_.push_back(translation.z);
+  qx_.push_back(rotation.x);
+  qy_.push_back(rotation.y);
+  qz_.push_back(rotation.z);
+  qw_.push_back(rotation.w);
+  sx_.push_back(scale.x);
+  sy_.push_back(scale.y);
+  sz_.push_back(scale.z);
+  parents_.push_back(parent);
+  dirty_.push_back(true);
+  world_matrices_.push_back(glm::mat4{1.0f});
+  any_dirty_ = true;
+
+  return handle;
+}
+
+void TransformStore::SetTranslation(Handle handle, const glm::vec3& translation) {
+  tx_[handle] = translation.x;
+  ty_[handle] = translation.y;
+  tz_[handle] = translation.z;
+  dirty_[handle] = true;
+  any_dirty_ = true;
+}
+
+void TransformStore::SetRotation(Handle handle, const glm::quat& rotation) {
+  qx_[handle] = rotation.x;
+  qy_[handle] = rotation.y;
+  qz_[handle] = rotation.z;
+  qw_[handle] = rotation.w;
+  dirty_[handle] = true;
+  any_dirty_ = true;
+}
+
+void TransformStore::SetScale(Handle handle, const glm::vec3& scale) {
+  sx_[handle] = scale.x;
+  sy_[handle] = scale.y;
+  sz_[handle] = scale.z;
+  dirty_[handle] = true;
+  any_dirty_ = true;
+}
+
+// Builds translate(t) * mat4_cast(r) * scale(s) directly, without
+// the three full matrix multiplications that the glm functions would do.
+// With SSE, every lane is a different transform, and the results are
+// transposed into four column major matrices at the end.
+void TransformStore::ComposeLocalMatrices(size_t first, size_t count, glm::mat4* out) const {
+#if TRANSFORM_STORE_USE_SSE
+  if (count == 4) {
+    __m128 x = _mm_loadu_ps(&qx_[first]), y = _mm_loadu_ps(&qy_[first]);
+    __m128 z = _mm_loadu_ps(&qz_[first]), w = _mm_loadu_ps(&qw_[first]);
+    __m128 sx = _mm_loadu_ps(&sx_[first]), sy = _mm_loadu_ps(&sy_[first]);
+    __m128 sz = _mm_loadu_ps(&sz_[first]);
+    __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+
+    __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+    __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+    __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+    // cols[col][row], the last row is set after the transpose
+    __m128 cols[4][4] = {
+      {_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+       _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx),
+       _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx),
+       _mm_setzero_ps()},
+      {_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy),
+       _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+       _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy),
+       _mm_setzero_ps()},
+      {_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz),
+       _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz),
+       _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz),
+       _mm_setzero_ps()},
+      {_mm_loadu_ps(&tx_[first]), _mm_loadu_ps(&ty_[first]),
+       _mm_loadu_ps(&tz_[first]), one}
+    };
+
+    for (int col = 0; col < 4; ++col) {
+      _MM_TRANSPOSE4_PS(cols[col][0], cols[col][1], cols[col][2], cols[col][3]);
+      for (int i = 0; i < 4; ++i) {
+        _mm_storeu_ps(&out[i][col][0], cols[col][i]);
+      }
+    }
+    return;
+  }
+#endif
+
+  for (size_t i = 0; i < count; ++i) {
+    size_t j = first + i;
+    float xx = qx_[j] * qx_[j], yy = qy_[j] * qy_[j], zz = qz_[j] * qz_[j];
+    float xy = qx_[j] * qy_[j], xz = qx_[j] * qz_[j], yz = qy_[j] * qz_[j];
+    float wx = qw_[j] * qx_[j], wy = qw_[j] * qy_[j], wz = qw_[j] * qz_[j];
+    float sx = sx_[j], sy = sy_[j], sz = sz_[j];
+
+    out[i][0] = glm::vec4{(1 - 2*(yy + zz)) * sx, 2*(xy + wz) * sx, 2*(xz - wy) * sx, 0.0f};
+    out[i][1] = glm::vec4{2*(xy - wz) * sy, (1 - 2*(xx + zz)) * sy, 2*(yz + wx) * sy, 0.0f};
+    out[i][2] = glm::vec4{2*(xz + wy) * sz, 2*(yz - wx) * sz, (1 - 2*(xx + yy)) * sz, 0.0f};
+    out[i][3] = glm::vec4{tx_[j], ty_[j], tz_[j], 1.0f};
+  }
+}
+
+#if TRANSFORM_STORE_USE_SSE
+static inline void MultiplyMatrix(const __m128 lhs[4], const float* rhs, float* out) {
+  for (int col = 0; col < 4; ++col) {
+    const float* r = rhs + 4*col;
+    __m128 result = _mm_mul_ps(lhs[0], _mm_set1_ps(r[0]));
+    result = _mm_add_ps(result, _mm_mul_ps(lhs[1], _mm_set1_ps(r[1])));
+    result = _mm_add_ps(result, _mm_mul_ps(lhs[2], _mm_set1_ps(r[2])));
+    result = _mm_add_ps(result, _mm_mul_ps(lhs[3], _mm_set1_ps(r[3])));
+    _mm_storeu_ps(out + 4*col, result);
+  }
+}
+#endif
+
+void MultiplyMatrices(const glm::mat4& lhs, const glm::mat4* rhs,
+                      glm::mat4* out, size_t count) {
+#if TRANSFORM_STORE_USE_SSE
+  const float* l = &lhs[0][0];
+  __m128 lhs_cols[4] = {_mm_loadu_ps(l), _mm_loadu_ps(l + 4),
+                        _mm_loadu_ps(l + 8), _mm_loadu_ps(l + 12)};
+  for (size_t i = 0; i < count; ++i) {
+    MultiplyMatrix(lhs_cols, &rhs[i][0][0], &out[i][0][0]);
+  }
+#else
+  for (size_t i = 0; i < count; ++i) {
+    out[i] = lhs * rhs[i];
+  }
+#endif
+}
+
+void TransformStore::Update() {
+  if (any_dirty_) {
+    UpdateImpl(nullptr, nullptr);
+  }
+}
+
+void TransformStore::Update(const glm::mat4& view_proj, std::vector<glm::mat4>* mvps) {
+  assert(mvps);
+  mvps->resize(world_matrices_.size());
+  UpdateImpl(&view_proj, mvps->data());
+}
+
+void TransformStore::UpdateImpl(const glm::mat4* view_proj, glm::mat4* mvps) {
+  size_t count = parents_.size();
+  for (size_t first = 0; first < count; first += 4) {
+    size_t block_size = std::min<size_t>(4, count - first);
+
+    if (any_dirty_) {
+      bool block_dirty = false;
+      for (size_t i = first; i < first + block_size; ++i) {
+        Handle parent = parents_[i];
+        if (parent != kNoParent && dirty_[parent]) {
+          // The parent has already been processed in this pass, so the
+          // flag propagates down the whole subtree.
+          dirty_[i] = true;
+        }
+        block_dirty |= dirty_[i] != 0;
+      }
+
+      if (block_dirty) {
+        glm::mat4 local[4];
+        ComposeLocalMatrices(first, block_size, local);
+        // In order, as a parent can be in the same block as its child
+        for (size_t i = 0; i < block_size; ++i) {
+          size_t handle = first + i;
+          if (!dirty_[handle]) {
+            continue;
+          }
+          Handle parent = parents_[handle];
+          if (parent != kNoParent) {
+            MultiplyMatrices(world_matrices_[parent], &local[i], &world_matrices_[handle], 1);
+          } else {
+            world_matrices_[handle] = local[i];
+          }
+        }
+      }
+    }
+
+    if (view_proj) {
+      MultiplyMatrices(*view_proj, &world_matrices_[first], &mvps[first], block_size);
+    }
+  }
+
+  std::fill(dirty_.begin(), dirty_.end(), 0);
+  any_dirty_ = false;
+}
+
+void TransformStore::ComputeMvps(const glm::mat4& view_proj,
+                                 std::vector<glm::mat4>* mvps) const {
+  assert(mvps);
+  mvps->resize(world_matrices_.size());
+  MultiplyMatrices(view_proj, world_matrices_.data(), mvps->data(), world_matrices_.size());
+}
@@ -0,0 +1,82 @@
+// Copyright (c), Tamas Csala
+
+#ifndef TRANSFORM_STORE_HPP_
+#define TRANSFORM_STORE_HPP_
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Stores the transformations of many objects in a structure-of-arrays layout.
+// Every component of the translations, rotations and scales lives in its own
+// float array, along with the index of the parent transform, so Update() can
+// compose the local matrices of four consecutive transforms at once with SSE.
+// The world matrices are cached, and only the dirty ones (or the ones whose
+// parent changed) are recomputed.
+//
+// A parent must always be added before its children, so a single linear pass
+// over the arrays is enough to resolve the hierarchy.
+class TransformStore {
+public:
+  using Handle = uint32_t;
+  static constexpr Handle kNoParent = ~Handle(0);
+
+  void Reserve(size_t count);
+
+  Handle Add(const glm::vec3& translation = glm::vec3{0.0f},
+             const glm::quat& rotation = glm::quat{1.0f, 0.0f, 0.0f, 0.0f},
+             const glm::vec3& scale = glm::vec3{1.0f},
+             Handle parent = kNoParent);
+
+  void SetTranslation(Handle handle, const glm::vec3& translation);
+  void SetRotation(Handle handle, const glm::quat& rotation);
+  void SetScale(Handle handle, const glm::vec3& scale);
+
+  glm::vec3 translation(Handle handle) const {
+    return glm::vec3{tx_[handle], ty_[handle], tz_[handle]};
+  }
+  glm::quat rotation(Handle handle) const {
+    return glm::quat{qw_[handle], qx_[handle], qy_[handle], qz_[handle]};
+  }
+  glm::vec3 scale(Handle handle) const {
+    return glm::vec3{sx_[handle], sy_[handle], sz_[handle]};
+  }
+  Handle parent(Handle handle) const { return parents_[handle]; }
+  size_t size() const { return parents_.size(); }
+
+  // Recomputes the world matrix of every dirty transform and its descendants.
+  void Update();
+
+  // Same as Update(), and computes view_proj * world for every transform in
+  // the same pass. The output is resized to size().
+  void Update(const glm::mat4& view_proj, std::vector<glm::mat4>* mvps);
+
+  // The cached world (model) matrix, valid after Update().
+  const glm::mat4& world_matrix(Handle handle) const { return world_matrices_[handle]; }
+  const std::vector<glm::mat4>& world_matrices() const { return world_matrices_; }
+
+  // Computes view_proj * world for every transform in one batched pass,
+  // for when more than one set of matrices is needed in a frame.
+  // The output is resized to size(). Call Update() first.
+  void ComputeMvps(const glm::mat4& view_proj, std::vector<glm::mat4>* mvps) const;
+
+private:
+  std::vector<float> tx_, ty_, tz_;
+  std::vector<float> qx_, qy_, qz_, qw_;
+  std::vector<float> sx_, sy_, sz_;
+  std::vector<Handle> parents_;
+  std::vector<uint8_t> dirty_;
+  std::vector<glm::mat4> world_matrices_;
+  bool any_dirty_ = false;
+
+  void UpdateImpl(const glm::mat4* view_proj, glm::mat4* mvps);
+  void ComposeLocalMatrices(size_t first, size_t count, glm::mat4* out) const;
+};
+
+// Multiplies 'count' matrices by the same left hand side matrix
+// (out[i] = lhs * rhs[i]), using SSE when it is available.
+void MultiplyMatrices(const glm::mat4& lhs, const glm::mat4* rhs,
+                      glm::mat4* out, size_t count);
+
+#endif
@@ -0,0 +1,77 @@
+// Copyright (c), Tamas Csala
+
+// Compares the per object glm path that the examples use
+// (proj_mat * camera_mat * model_mat, with the model matrix built by
+// glm::translate / glm::rotate / glm::scale) with the batched TransformStore.
+
+#include "transform_store.hpp"
+
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <glm/gtc/matrix_transform.hpp>
+
+static constexpr size_t kTransformCount = 1000000;
+static constexpr int kFrameCount = 20;
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double ElapsedMs(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main() {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+
+  std::vector<glm::vec3> translations(kTransformCount);
+  std::vector<glm::quat> rotations(kTransformCount);
+  std::vector<glm::vec3> scales(kTransformCount);
+
+  TransformStore store;
+  store.Reserve(kTransformCount);
+  for (size_t i = 0; i < kTransformCount; ++i) {
+    translations[i] = glm::vec3{dist(rng), dist(rng), dist(rng)};
+    rotations[i] = glm::angleAxis(dist(rng), glm::normalize(glm::vec3{dist(rng), dist(rng), dist(rng)}));
+    scales[i] = glm::vec3{1.0f + 0.05f*dist(rng)};
+    store.Add(translations[i], rotations[i], scales[i]);
+  }
+
+  glm::mat4 camera_mat = glm::lookAt(glm::vec3{0, 5, 20}, glm::vec3{0, 0, 0}, glm::vec3{0, 1, 0});
+  glm::mat4 proj_mat = glm::perspectiveFov<float>(M_PI/3.0, 600, 600, 0.1, 100);
+
+  std::vector<glm::mat4> models(kTransformCount), mvps(kTransformCount);
+  double checksum = 0;
+
+  // Every transform changes every frame, this is the worst case for the store.
+  double glm_ms = 0, store_ms = 0;
+  for (int frame = 0; frame < kFrameCount; ++frame) {
+    float offset = frame * 1e-3f;
+
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < kTransformCount; ++i) {
+      glm::mat4 model_mat = glm::translate(glm::mat4{1.0f}, translations[i] + offset);
+      model_mat = model_mat * glm::mat4_cast(rotations[i]);
+      model_mat = glm::scale(model_mat, scales[i]);
+      models[i] = model_mat;
+      mvps[i] = proj_mat * camera_mat * model_mat;
+    }
+    glm_ms += ElapsedMs(start);
+    checksum += mvps[frame][3][0];
+
+    // Setting the translations is timed too, like in the glm path
+    start = Clock::now();
+    for (size_t i = 0; i < kTransformCount; ++i) {
+      store.SetTranslation(i, translations[i] + offset);
+    }
+    store.Update(proj_mat * camera_mat, &mvps);
+    store_ms += ElapsedMs(start);
+    checksum += mvps[frame][3][0];
+  }
+
+  std::cout << kTransformCount << " transforms, average of " << kFrameCount << " frames" << std::endl;
+  std::cout << "  glm per object: " << glm_ms / kFrameCount << " ms/frame" << std::endl;
+  std::cout << "  TransformStore: " << store_ms / kFrameCount << " ms/frame" << std::endl;
+  std::cout << "  (checksum: " << checksum << ")" << std::endl;
+}
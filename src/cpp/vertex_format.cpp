@@ -0,0 +1,167 @@
+// Copyright (c), Tamas Csala
+
+#include "vertex_format.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+
+static size_t PositionSize(VertexFormat::Position format) {
+  switch (format) {
+    case VertexFormat::Position::kFloat: return 3*sizeof(float);
+    case VertexFormat::Position::kHalfFloat: return 4*sizeof(uint16_t);
+    case VertexFormat::Position::kNormalizedShort: return 4*sizeof(int16_t);
+  }
+  return 0;
+}
+
+static size_t NormalSize(VertexFormat::Normal format) {
+  switch (format) {
+    case VertexFormat::Normal::kNone: return 0;
+    case VertexFormat::Normal::kFloat: return 3*sizeof(float);
+    case VertexFormat::Normal::kPacked: return sizeof(uint32_t);
+  }
+  return 0;
+}
+
+static size_t TexCoordSize(VertexFormat::TexCoord format) {
+  switch (format) {
+    case VertexFormat::TexCoord::kNone: return 0;
+    case VertexFormat::TexCoord::kFloat: return 2*sizeof(float);
+    case VertexFormat::TexCoord::kUnorm16: return sizeof(uint32_t);
+  }
+  return 0;
+}
+
+VertexFormat::VertexFormat(Position position, Normal normal, TexCoord texcoord)
+    : position_(position), normal_(normal), texcoord_(texcoord) {
+  normal_offset_ = PositionSize(position);
+  texcoord_offset_ = normal_offset_ + NormalSize(normal);
+  stride_ = texcoord_offset_ + TexCoordSize(texcoord);
+}
+
+std::vector<uint8_t> VertexFormat::Pack(const std::vector<glm::vec3>& positions,
+                                        const std::vector<glm::vec3>& normals,
+                                        const std::vector<glm::vec2>& texcoords) {
+  assert(normal_ == Normal::kNone || normals.size() == positions.size());
+  assert(texcoord_ == TexCoord::kNone || texcoords.size() == positions.size());
+
+  return Pack(positions.size(), positions.data(), normals.data(), texcoords.data());
+}
+
+std::vector<uint8_t> VertexFormat::Pack(size_t vertex_count,
+                                        const glm::vec3* positions,
+                                        const glm::vec3* normals,
+                                        const glm::vec2* texcoords) {
+  assert(normal_ == Normal::kNone || normals);
+  assert(texcoord_ == TexCoord::kNone || texcoords);
+
+  position_scale_ = glm::vec3{1.0f};
+  position_bias_ = glm::vec3{0.0f};
+  if (position_ != Position::kFloat && vertex_count > 0) {
+    glm::vec3 min = positions[0], max = positions[0];
+    for (size_t i = 1; i < vertex_count; ++i) {
+      min = glm::min(min, positions[i]);
+      max = glm::max(max, positions[i]);
+    }
+    position_bias_ = (min + max) / 2.0f;
+    // Avoid dividing by zero for flat meshes
+    position_scale_ = glm::max((max - min) / 2.0f, glm::vec3{1e-6f});
+  }
+
+  std::vector<uint8_t> data(vertex_count * stride_);
+  for (size_t i = 0; i < vertex_count; ++i) {
+    uint8_t* vertex = data.data() + i*stride_;
+
+    glm::vec3 pos = (positions[i] - position_bias_) / position_scale_;
+    switch (position_) {
+      case Position::kFloat: {
+        memcpy(vertex, &pos, sizeof(pos));
+      } break;
+      case Position::kHalfFloat: {
+        uint16_t packed[4] = {glm::packHalf1x16(pos.x), glm::packHalf1x16(pos.y),
+                              glm::packHalf1x16(pos.z), 0};
+        memcpy(vertex, packed, sizeof(packed));
+      } break;
+      case Position::kNormalizedShort: {
+        glm::vec3 clamped = glm::round(glm::clamp(pos, -1.0f, 1.0f) * 32767.0f);
+        int16_t packed[4] = {int16_t(clamped.x), int16_t(clamped.y), int16_t(clamped.z), 0};
+        memcpy(vertex, packed, sizeof(packed));
+      } break;
+    }
+
+    switch (normal_) {
+      case Normal::kNone: break;
+      case Normal::kFloat: {
+        memcpy(vertex + normal_offset_, &normals[i], sizeof(glm::vec3));
+      } break;
+      case Normal::kPacked: {
+        // packSnorm3x10_1x2 stores x in the lowest bits, that is the
+        // GL_INT_2_10_10_10_REV layout.
+        uint32_t packed = glm::packSnorm3x10_1x2(glm::vec4{normals[i], 0.0f});
+        memcpy(vertex + normal_offset_, &packed, sizeof(packed));
+      } break;
+    }
+
+    switch (texcoord_) {
+      case TexCoord::kNone: break;
+      case TexCoord::kFloat: {
+        memcpy(vertex + texcoord_offset_, &texcoords[i], sizeof(glm::vec2));
+      } break;
+      case TexCoord::kUnorm16: {
+        uint32_t packed = glm::packUnorm2x16(texcoords[i]);
+        memcpy(vertex + texcoord_offset_, &packed, sizeof(packed));
+      } break;
+    }
+  }
+
+  return data;
+}
+
+void VertexFormat::SetupAttribs(GLuint position_location,
+                                GLuint normal_location,
+                                GLuint texcoord_location) const {
+  GLsizei stride = static_cast<GLsizei>(stride_);
+
+  gl::VertexAttrib positions(position_location);
+  switch (position_) {
+    case Position::kFloat:
+      positions.pointer(3, gl::DataType::kFloat, false, stride, (void*)0);
+      break;
+    case Position::kHalfFloat:
+      positions.pointer(3, static_cast<gl::DataType>(GL_HALF_FLOAT), false, stride, (void*)0);
+      break;
+    case Position::kNormalizedShort:
+      positions.pointer(3, static_cast<gl::DataType>(GL_SHORT), true, stride, (void*)0);
+      break;
+  }
+  positions.enable();
+
+  if (normal_ != Normal::kNone) {
+    gl::VertexAttrib normals(normal_location);
+    if (normal_ == Normal::kFloat) {
+      normals.pointer(3, gl::DataType::kFloat, false, stride, (void*)normal_offset_);
+    } else {
+      // Packed formats always have to specify 4 components
+      normals.pointer(4, static_cast<gl::DataType>(GL_INT_2_10_10_10_REV), true,
+                      stride, (void*)normal_offset_);
+    }
+    normals.enable();
+  }
+
+  if (texcoord_ != TexCoord::kNone) {
+    gl::VertexAttrib texcoords(texcoord_location);
+    if (texcoord_ == TexCoord::kFloat) {
+      texcoords.pointer(2, gl::DataType::kFloat, false, stride, (void*)texcoord_offset_);
+    } else {
+      texcoords.pointer(2, static_cast<gl::DataType>(GL_UNSIGNED_SHORT), true,
+                        stride, (void*)texcoord_offset_);
+    }
+    texcoords.enable();
+  }
+}
+
+void VertexFormat::SetDequantizationUniforms(gl::Program& prog) const {
+  gl::Uniform<glm::vec3>(prog, "uPositionScale") = position_scale_;
+  gl::Uniform<glm::vec3>(prog, "uPositionBias") = position_bias_;
+}
@@ -0,0 +1,88 @@
+// Copyright (c), Tamas Csala
+
+#ifndef VERTEX_FORMAT_HPP_
+#define VERTEX_FORMAT_HPP_
+
+#include <vector>
+#include <cstdint>
+#include <glad/glad.h>
+#include <oglwrap/oglwrap.h>
+#include <glm/glm.hpp>
+
+// Describes an interleaved, optionally quantized vertex layout, packs vertex
+// data into it, and sets up the matching vertex attributes.
+//
+// Quantized positions are stored relative to the mesh's bounding box, mapped
+// to [-1, 1]. The shaders have to undo this with
+//   position = inPos.xyz * uPositionScale + uPositionBias
+// the uniforms are set by SetDequantizationUniforms(). For kFloat positions
+// the scale is one and the bias is zero, so the same shader works for both.
+class VertexFormat {
+public:
+  enum class Position {
+    kFloat,            // 3 x float, 12 bytes
+    kHalfFloat,        // 3 x half float + padding, 8 bytes
+    kNormalizedShort   // 3 x snorm16 + padding, 8 bytes
+  };
+
+  enum class Normal {
+    kNone,
+    kFloat,            // 3 x float, 12 bytes
+    kPacked            // GL_INT_2_10_10_10_REV, 4 bytes
+  };
+
+  enum class TexCoord {
+    kNone,
+    kFloat,            // 2 x float, 8 bytes
+    kUnorm16           // 2 x unorm16, 4 bytes
+  };
+
+  explicit VertexFormat(Position position = Position::kFloat,
+                        Normal normal = Normal::kFloat,
+                        TexCoord texcoord = TexCoord::kNone);
+
+  // The size of one vertex in bytes.
+  size_t stride() const { return stride_; }
+
+  // Packs the vertices into an interleaved byte array, and calculates the
+  // dequantization parameters from their bounding box. The normals and
+  // texcoords arrays must either be empty, or have the same size as the
+  // positions, depending on whether the format uses them.
+  std::vector<uint8_t> Pack(const std::vector<glm::vec3>& positions,
+                            const std::vector<glm::vec3>& normals,
+                            const std::vector<glm::vec2>& texcoords = {});
+
+  // Same as above, for vertices that aren't stored in std::vectors. The
+  // normals and texcoords can be null if the format doesn't use them.
+  std::vector<uint8_t> Pack(size_t vertex_count,
+                            const glm::vec3* positions,
+                            const glm::vec3* normals,
+                            const glm::vec2* texcoords = nullptr);
+
+  // Sets up the attribute pointers for the currently bound vertex array,
+  // reading from the currently bound array buffer. Attributes that the
+  // format doesn't have are skipped.
+  void SetupAttribs(GLuint position_location,
+                    GLuint normal_location,
+                    GLuint texcoord_location = 0) const;
+
+  // Sets uPositionScale and uPositionBias. The program has to be in use.
+  void SetDequantizationUniforms(gl::Program& prog) const;
+
+  glm::vec3 position_scale() const { return position_scale_; }
+  glm::vec3 position_bias() const { return position_bias_; }
+
+private:
+  Position position_;
+  Normal normal_;
+  TexCoord texcoord_;
+
+  size_t stride_;
+  size_t normal_offset_;
+  size_t texcoord_offset_;
+
+  glm::vec3 position_scale_{1.0f};
+  glm::vec3 position_bias_{0.0f};
+};
+
+#endif
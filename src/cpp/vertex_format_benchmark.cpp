@@ -0,0 +1,177 @@
+// Copyright (c), Tamas Csala
+
+// Measures the memory footprint and the vertex fetch throughput of the
+// VertexFormat layouts on a large tessellated sphere. Rasterization is
+// disabled, so the timings are dominated by vertex fetching.
+
+#include "oglwrap_example.hpp"
+#include "vertex_format.hpp"
+#include "benchmark_util.hpp"
+
+#include <cmath>
+#include <memory>
+#include <glm/gtc/matrix_transform.hpp>
+
+class VertexFormatBenchmark : public OglwrapExample {
+private:
+  static constexpr int kSlices = 512;
+  static constexpr int kStacks = 256;
+  static constexpr int kDrawsPerFrame = 8;
+  static constexpr int kFrameCount = 100;
+
+  enum AttributeLocation { kPosition, kNormal, kTexCoord };
+
+  struct Layout {
+    Layout(const char* name, const VertexFormat& format)
+        : name(name), format(format) {}
+
+    const char* name;
+    VertexFormat format;
+    gl::VertexArray vao;
+    gl::ArrayBuffer buffer;
+    GLuint query = 0;
+    double total_ns = 0;
+    size_t bytes = 0;
+  };
+
+  std::vector<std::unique_ptr<Layout>> layouts_;
+  GLsizei vertex_count_ = 0;
+  gl::Program prog_;
+  int frame_ = 0;
+
+public:
+  VertexFormatBenchmark () {
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> texcoords;
+    // Offset the sphere, so the quantization bounding box isn't trivial
+    BuildSphere(kSlices, kStacks, glm::vec3{10, 20, 30}, 5.0f, &positions, &normals, &texcoords);
+    vertex_count_ = positions.size();
+
+    using VF = VertexFormat;
+    AddLayout("float pos, float normal, float uv",
+              VF{VF::Position::kFloat, VF::Normal::kFloat, VF::TexCoord::kFloat},
+              positions, normals, texcoords);
+    AddLayout("half pos, packed normal, unorm16 uv",
+              VF{VF::Position::kHalfFloat, VF::Normal::kPacked, VF::TexCoord::kUnorm16},
+              positions, normals, texcoords);
+    AddLayout("snorm16 pos, packed normal, unorm16 uv",
+              VF{VF::Position::kNormalizedShort, VF::Normal::kPacked, VF::TexCoord::kUnorm16},
+              positions, normals, texcoords);
+
+    gl::ShaderSource vs_source;
+    vs_source.set_source(R"""(
+      #version 330 core
+      in vec4 inPos;
+      in vec3 inNormal;
+      in vec2 inTexCoord;
+
+      uniform mat4 mvp;
+      uniform vec3 uPositionScale, uPositionBias;
+
+      void main() {
+        // Every attribute has to contribute, so that none of them is optimized out
+        vec3 pos = inPos.xyz * uPositionScale + uPositionBias;
+        gl_Position = mvp * vec4(pos + 1e-3*inNormal + 1e-3*vec3(inTexCoord, 0), 1.0);
+      })""");
+    vs_source.set_source_file("benchmark.vert");
+    gl::Shader vs(gl::kVertexShader, vs_source);
+
+    gl::ShaderSource fs_source;
+    fs_source.set_source(R"""(
+      #version 330 core
+      out vec4 fragColor;
+
+      void main() {
+        fragColor = vec4(1.0);
+      })""");
+    fs_source.set_source_file("benchmark.frag");
+    gl::Shader fs(gl::kFragmentShader, fs_source);
+
+    prog_.attachShader(vs);
+    prog_.attachShader(fs);
+    (prog_ | "inPos").bindLocation(kPosition);
+    (prog_ | "inNormal").bindLocation(kNormal);
+    (prog_ | "inTexCoord").bindLocation(kTexCoord);
+    prog_.link();
+  }
+
+  ~VertexFormatBenchmark() {
+    for (auto& layout : layouts_) {
+      glDeleteQueries(1, &layout->query);
+    }
+  }
+
+protected:
+  virtual void Render() override {
+    gl::Use(prog_);
+    gl::Uniform<glm::mat4>(prog_, "mvp") = glm::mat4{1.0f};
+    glEnable(GL_RASTERIZER_DISCARD);
+
+    for (auto& layout : layouts_) {
+      layout->format.SetDequantizationUniforms(prog_);
+      gl::Bind(layout->vao);
+      glBeginQuery(GL_TIME_ELAPSED, layout->query);
+      for (int i = 0; i < kDrawsPerFrame; ++i) {
+        gl::DrawArrays(gl::PrimType::kTriangles, 0, vertex_count_);
+      }
+      glEndQuery(GL_TIME_ELAPSED);
+      gl::Unbind(layout->vao);
+
+      // Blocks until the draws are finished, that's fine for a benchmark.
+      GLuint64 elapsed_ns = 0;
+      glGetQueryObjectui64v(layout->query, GL_QUERY_RESULT, &elapsed_ns);
+      layout->total_ns += elapsed_ns;
+    }
+
+    glDisable(GL_RASTERIZER_DISCARD);
+    gl::Unuse(prog_);
+
+    if (++frame_ == kFrameCount) {
+      PrintResults();
+      glfwSetWindowShouldClose(window_, true);
+    }
+  }
+
+private:
+  void AddLayout(const char* name, const VertexFormat& format,
+                 const std::vector<glm::vec3>& positions,
+                 const std::vector<glm::vec3>& normals,
+                 const std::vector<glm::vec2>& texcoords) {
+    std::unique_ptr<Layout> layout{new Layout(name, format)};
+
+    std::vector<uint8_t> data = layout->format.Pack(positions, normals, texcoords);
+    layout->bytes = data.size();
+
+    gl::Bind(layout->vao);
+    gl::Bind(layout->buffer);
+    layout->buffer.data(data);
+    layout->format.SetupAttribs(kPosition, kNormal, kTexCoord);
+    gl::Unbind(layout->buffer);
+    gl::Unbind(layout->vao);
+
+    glGenQueries(1, &layout->query);
+    layouts_.push_back(std::move(layout));
+  }
+
+  void PrintResults() const {
+    double vertices = double(vertex_count_) * kDrawsPerFrame * kFrameCount;
+    size_t baseline_bytes = layouts_.front()->bytes;
+
+    std::cout << vertex_count_ << " vertices, " << kDrawsPerFrame << " draws per frame, "
+              << kFrameCount << " frames" << std::endl;
+    for (const auto& layout : layouts_) {
+      double seconds = layout->total_ns * 1e-9;
+      std::cout << "  " << layout->name << ": "
+                << layout->format.stride() << " bytes/vertex, "
+                << layout->bytes / (1024.0 * 1024.0) << " MiB ("
+                << 100.0 * (baseline_bytes - layout->bytes) / baseline_bytes << "% saved), "
+                << vertices / seconds * 1e-6 << " Mvertices/s" << std::endl;
+    }
+  }
+};
+
+int main(int argc, char* argv[]) {
+  VertexFormatBenchmark benchmark;
+  benchmark.ParseCommandLine(argc, argv);
+  benchmark.RunMainLoop();
+}
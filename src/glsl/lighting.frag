@@ -0,0 +1,101 @@
+#version 330 core
+
+// Shared by the examples, see ShaderPermutations for the features.
+
+in vec3 normal;
+
+uniform vec3 color;
+uniform vec3 lightPos;
+uniform float ambient;
+
+#if defined(SHADOWS) || defined(CLUSTERED_LIGHTS)
+  in vec3 position;
+#endif
+
+#ifdef SHADOWS
+  uniform mat4 shadowTransform;
+  uniform sampler2DShadow shadowMap;
+
+  #ifndef PCF_KERNEL_SIZE
+    #define PCF_KERNEL_SIZE 1
+  #endif
+
+  float ShadowVisibility() {
+    vec4 shadow_coord = shadowTransform * vec4(position, 1.0);
+    shadow_coord.xyz /= shadow_coord.w;
+    shadow_coord.z -= 0.005;
+    shadow_coord.xyz = (shadow_coord.xyz + 1) * 0.5;
+
+  #if PCF_KERNEL_SIZE > 1
+    vec2 texel_size = 1.0 / vec2(textureSize(shadowMap, 0));
+    float visibility = 0.0;
+    for (int x = -PCF_KERNEL_SIZE/2; x <= PCF_KERNEL_SIZE/2; ++x) {
+      for (int y = -PCF_KERNEL_SIZE/2; y <= PCF_KERNEL_SIZE/2; ++y) {
+        vec2 offset = vec2(x, y) * texel_size;
+        visibility += texture(shadowMap, vec3(shadow_coord.xy + offset, shadow_coord.z));
+      }
+    }
+    return visibility / float(PCF_KERNEL_SIZE * PCF_KERNEL_SIZE);
+  #else
+    return texture(shadowMap, shadow_coord.xyz);
+  #endif
+  }
+#endif
+
+#ifdef CLUSTERED_LIGHTS
+  // See ClusteredLights
+  uniform usamplerBuffer uClusters;      // (offset, count) per cluster
+  uniform usamplerBuffer uLightIndices;
+  uniform samplerBuffer uLights;         // (position, radius), (color, 0) per light
+  uniform ivec3 uClusterGrid;
+  uniform vec2 uScreenSize;
+  uniform vec2 uNearFar;
+
+  int ClusterIndex() {
+    float z_near = uNearFar.x, z_far = uNearFar.y;
+    float z_ndc = 2.0*gl_FragCoord.z - 1.0;
+    float depth = 2.0*z_near*z_far / (z_far + z_near - z_ndc*(z_far - z_near));
+
+    int slice = int(log(depth / z_near) / log(z_far / z_near) * uClusterGrid.z);
+    ivec2 tile = ivec2(gl_FragCoord.xy / uScreenSize * vec2(uClusterGrid.xy));
+    slice = clamp(slice, 0, uClusterGrid.z - 1);
+    tile = clamp(tile, ivec2(0), uClusterGrid.xy - 1);
+
+    return (slice*uClusterGrid.y + tile.y)*uClusterGrid.x + tile.x;
+  }
+
+  vec3 PointLighting(vec3 n) {
+    uvec2 range = texelFetch(uClusters, ClusterIndex()).xy;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; ++i) {
+      int light = int(texelFetch(uLightIndices, int(range.x + i)).x);
+      vec4 position_and_radius = texelFetch(uLights, 2*light);
+      vec3 light_color = texelFetch(uLights, 2*light + 1).rgb;
+
+      vec3 to_light = position_and_radius.xyz - position;
+      float dist = length(to_light);
+      float attenuation = max(1.0 - dist / position_and_radius.w, 0.0);
+      result += attenuation*attenuation * max(dot(n, to_light / dist), 0.0) * light_color;
+    }
+    return result;
+  }
+#endif
+
+out vec4 fragColor;
+
+void main() {
+  float diffuse = max(dot(lightPos, normalize(normal)), 0.0);
+#ifdef SHADOWS
+  diffuse *= 0.2 + 0.8*ShadowVisibility();
+#endif
+
+  vec3 lit_color = ((1.0 - ambient)*diffuse + ambient) * color;
+#ifdef CLUSTERED_LIGHTS
+  lit_color += PointLighting(normalize(normal)) * color;
+#endif
+#ifdef SRGB_OUTPUT
+  lit_color = pow(lit_color, vec3(1.0/2.2));
+#endif
+  fragColor = vec4(lit_color, 1.0);
+}
@@ -0,0 +1,80 @@
+#version 330 core
+
+// Shared by the examples, see ShaderPermutations for the features.
+
+in vec4 inPos;
+in vec3 inNormal;
+
+#ifdef MULTI_VIEW
+  // See MultiView. Every object is drawn with uViewCount times as many
+  // instances, and consecutive instances go to different views.
+  #ifndef MAX_VIEWS
+    #define MAX_VIEWS 4
+  #endif
+  uniform mat4 uViewProjs[MAX_VIEWS];
+  uniform vec4 uViewRects[MAX_VIEWS];  // (offset, scale) in NDC
+  uniform int uViewCount;
+  #define VIEW_ID (gl_InstanceID % uViewCount)
+  #define INSTANCE_ID (gl_InstanceID / uViewCount)
+#else
+  #define INSTANCE_ID gl_InstanceID
+#endif
+
+#ifdef INSTANCING
+  // Two mat4 per instance, GL 3.3 only guarantees 1024 vertex uniform components
+  #ifndef MAX_INSTANCES
+    #define MAX_INSTANCES 16
+  #endif
+  uniform mat4 mvps[MAX_INSTANCES];
+  uniform mat4 model_mats[MAX_INSTANCES];
+  #define MVP mvps[INSTANCE_ID]
+  #define MODEL_MAT model_mats[INSTANCE_ID]
+#else
+  uniform mat4 mvp;
+  uniform mat4 model_mat;
+  #define MVP mvp
+  #define MODEL_MAT model_mat
+#endif
+
+#ifdef MULTI_VIEW
+  // The per object mvp is replaced by the view's matrix
+  #undef MVP
+  #define MVP (uViewProjs[VIEW_ID] * MODEL_MAT)
+#endif
+
+#ifdef QUANTIZED_POSITIONS
+  uniform vec3 uPositionScale, uPositionBias;
+#endif
+
+#if defined(SHADOWS) || defined(CLUSTERED_LIGHTS)
+  out vec3 position;
+#endif
+out vec3 normal;
+
+void main() {
+#ifdef QUANTIZED_POSITIONS
+  vec4 pos = vec4(inPos.xyz * uPositionScale + uPositionBias, 1.0);
+#else
+  vec4 pos = inPos;
+#endif
+
+  normal = inNormal;
+#if defined(SHADOWS) || defined(CLUSTERED_LIGHTS)
+  position = vec3(MODEL_MAT * pos);
+#endif
+  gl_Position = MVP * pos;
+
+#ifdef MULTI_VIEW
+  // Without gl_ViewportIndex in the vertex shader, the view is squeezed into
+  // its part of the screen, and the clip distances cut off what would spill
+  // over into the neighbouring views.
+  vec4 clip = gl_Position;
+  gl_ClipDistance[0] = clip.w + clip.x;
+  gl_ClipDistance[1] = clip.w - clip.x;
+  gl_ClipDistance[2] = clip.w + clip.y;
+  gl_ClipDistance[3] = clip.w - clip.y;
+
+  vec4 rect = uViewRects[VIEW_ID];
+  gl_Position.xy = clip.xy * rect.zw + rect.xy * clip.w;
+#endif
+}